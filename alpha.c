@@ -0,0 +1,270 @@
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include "da.h"
+#include "delaunay.h"
+#include "alpha.h"
+
+typedef struct {
+   float radius;
+   Index triangle;
+} RadiusKey;
+
+int sort_by_radius(const void* aa, const void* bb)
+{
+   const RadiusKey* a = (const RadiusKey*)aa;
+   const RadiusKey* b = (const RadiusKey*)bb;
+
+   return (a->radius > b->radius) - (a->radius < b->radius);
+}
+
+int sort_by_enter(const void* aa, const void* bb)
+{
+   const AlphaEdge* a = (const AlphaEdge*)aa;
+   const AlphaEdge* b = (const AlphaEdge*)bb;
+
+   return (a->enter > b->enter) - (a->enter < b->enter);
+}
+
+int sort_by_leave_down(const void* aa, const void* bb)
+{
+   const AlphaEdge* a = (const AlphaEdge*)aa;
+   const AlphaEdge* b = (const AlphaEdge*)bb;
+
+   return (a->leave < b->leave) - (a->leave > b->leave);
+}
+
+float triangle_radius(Delaunay* delaunay, Index t)
+{
+   if (t == -1)
+   {
+      return INFINITY;
+   }
+
+   Triangle* tr = &TRIA(delaunay, t);
+   if (IS_SUPER_POINT(delaunay, tr->ix1) || IS_SUPER_POINT(delaunay, tr->ix2) || IS_SUPER_POINT(delaunay, tr->ix3))
+   {
+      return INFINITY;
+   }
+
+   return tr->circle.radius;
+}
+
+// items is sorted by enter and stays so through the stable partition in
+// [left | right | middle], the middle ones go to the node.
+Index alpha_build(AlphaIndex* alpha, AlphaEdge* items, AlphaEdge* temp, Index count)
+{
+   if (count == 0)
+   {
+      return -1;
+   }
+
+   float center = items[count / 2].enter;
+   Index left = 0;
+   Index right = 0;
+   for (Index i = 0; i < count; ++i)
+   {
+      left += items[i].leave <= center;
+      right += items[i].enter > center;
+   }
+
+   Index l = 0;
+   Index r = left;
+   Index m = left + right;
+   for (Index i = 0; i < count; ++i)
+   {
+      if (items[i].leave <= center)
+      {
+         temp[l++] = items[i];
+      }
+      else if (items[i].enter > center)
+      {
+         temp[r++] = items[i];
+      }
+      else
+      {
+         temp[m++] = items[i];
+      }
+   }
+
+   for (Index i = 0; i < count; ++i)
+   {
+      items[i] = temp[i];
+   }
+
+   AlphaNode node = {
+      .center = center,
+      .begin = alpha->edge_count,
+      .end = alpha->edge_count + count - left - right
+   };
+   for (Index i = left + right; i < count; ++i)
+   {
+      alpha->by_enter[alpha->edge_count] = items[i];
+      alpha->by_leave[alpha->edge_count] = items[i];
+      alpha->edge_count++;
+   }
+   qsort(alpha->by_leave + node.begin, node.end - node.begin, sizeof(AlphaEdge), sort_by_leave_down);
+
+   Index self = alpha->nodes.count;
+   da_append(&alpha->nodes, node);
+   Index left_node = alpha_build(alpha, items, temp, left);
+   Index right_node = alpha_build(alpha, items + left, temp, right);
+   alpha->nodes.items[self].left = left_node;
+   alpha->nodes.items[self].right = right_node;
+   return self;
+}
+
+AlphaIndex delaunay_alpha_index(Delaunay* delaunay)
+{
+   AlphaIndex alpha = { 0 };
+   Index n = delaunay->triangles.count;
+
+   // triangles
+   RadiusKey* keys = malloc((n > 0 ? n : 1) * sizeof(RadiusKey));
+   for (Index t = 0; t < n; ++t)
+   {
+      float radius = triangle_radius(delaunay, t);
+      if (radius != INFINITY)
+      {
+         keys[alpha.triangle_count++] = (RadiusKey) { .radius = radius, .triangle = t };
+      }
+   }
+   qsort(keys, alpha.triangle_count, sizeof(RadiusKey), sort_by_radius);
+
+   alpha.triangles = malloc((alpha.triangle_count > 0 ? alpha.triangle_count : 1) * sizeof(Index));
+   alpha.radii = malloc((alpha.triangle_count > 0 ? alpha.triangle_count : 1) * sizeof(float));
+   assert(alpha.triangles != NULL && alpha.radii != NULL && "Buy more RAM lol");
+   for (Index i = 0; i < alpha.triangle_count; ++i)
+   {
+      alpha.triangles[i] = keys[i].triangle;
+      alpha.radii[i] = keys[i].radius;
+   }
+   free(keys);
+
+   // edges, each once from the triangle with the lower index, that are on
+   // the border for some alpha
+   Index capacity = 3 * (n > 0 ? n : 1);
+   AlphaEdge* items = malloc(capacity * sizeof(AlphaEdge));
+   Index count = 0;
+   for (Index t = 0; t < n; ++t)
+   {
+      Triangle* tr = &TRIA(delaunay, t);
+      Index ix[3] = { tr->ix1, tr->ix2, tr->ix3 };
+      float radius = triangle_radius(delaunay, t);
+      for (int e = 0; e < 3; ++e)
+      {
+         int slot;
+         Index u = ix[e];
+         Index v = ix[(e + 1) % 3];
+         Index other = neighbour_across(delaunay, tr, u, v, &slot);
+         if (other != -1 && other < t)
+         {
+            continue;
+         }
+
+         float other_radius = triangle_radius(delaunay, other);
+         if (radius == other_radius)
+         {
+            continue;
+         }
+
+         // oriented around the inside one, the smaller
+         Index inside = radius < other_radius ? t : other;
+         Triangle* in = &TRIA(delaunay, inside);
+         Index w = in->ix1 != u && in->ix1 != v ? in->ix1 : (in->ix2 != u && in->ix2 != v ? in->ix2 : in->ix3);
+         if (orient2d(&POINT(delaunay, u), &POINT(delaunay, v), &POINT(delaunay, w)) < 0)
+         {
+            Index temp = u;
+            u = v;
+            v = temp;
+         }
+
+         items[count++] = (AlphaEdge) {
+            .u = u,
+            .v = v,
+            .enter = fminf(radius, other_radius),
+            .leave = fmaxf(radius, other_radius)
+         };
+      }
+   }
+   qsort(items, count, sizeof(AlphaEdge), sort_by_enter);
+
+   AlphaEdge* temp = malloc((count > 0 ? count : 1) * sizeof(AlphaEdge));
+   alpha.by_enter = malloc((count > 0 ? count : 1) * sizeof(AlphaEdge));
+   alpha.by_leave = malloc((count > 0 ? count : 1) * sizeof(AlphaEdge));
+   assert(temp != NULL && alpha.by_enter != NULL && alpha.by_leave != NULL && "Buy more RAM lol");
+   alpha.root = alpha_build(&alpha, items, temp, count);
+
+   free(items);
+   free(temp);
+   return alpha;
+}
+
+void delaunay_alpha_free(AlphaIndex* alpha)
+{
+   free(alpha->triangles);
+   free(alpha->radii);
+   free(alpha->by_enter);
+   free(alpha->by_leave);
+   da_free(alpha->nodes);
+   *alpha = (AlphaIndex) { 0 };
+}
+
+Index delaunay_alpha_triangles(AlphaIndex* alpha, float value)
+{
+   Index lo = 0;
+   Index hi = alpha->triangle_count;
+   while (lo < hi)
+   {
+      Index mid = lo + (hi - lo) / 2;
+      if (alpha->radii[mid] <= value)
+      {
+         lo = mid + 1;
+      }
+      else
+      {
+         hi = mid;
+      }
+   }
+
+   return lo;
+}
+
+Index delaunay_alpha_border(AlphaIndex* alpha, float value, Indices* border)
+{
+   border->count = 0;
+   if (value > FLT_MAX)
+   {
+      // the hull edges stay on the border up to infinity
+      value = FLT_MAX;
+   }
+
+   // down the tree, on every node the edges holding value come first in
+   // one of the two orders
+   Index node = alpha->root;
+   while (node != -1)
+   {
+      AlphaNode* an = &alpha->nodes.items[node];
+      if (value < an->center)
+      {
+         for (Index i = an->begin; i < an->end && alpha->by_enter[i].enter <= value; ++i)
+         {
+            da_append(border, alpha->by_enter[i].u);
+            da_append(border, alpha->by_enter[i].v);
+         }
+         node = an->left;
+      }
+      else
+      {
+         for (Index i = an->begin; i < an->end && alpha->by_leave[i].leave > value; ++i)
+         {
+            da_append(border, alpha->by_leave[i].u);
+            da_append(border, alpha->by_leave[i].v);
+         }
+         node = an->right;
+      }
+   }
+
+   return border->count / 2;
+}
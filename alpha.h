@@ -0,0 +1,59 @@
+#ifndef _ALPHA_H_
+#define _ALPHA_H_
+
+#include "delaunay.h"
+
+// An edge of the mesh while it is on the border of the alpha shape: from
+// enter, the circumradius of the smaller triangle at it, up to leave, the
+// radius of the other one (INFINITY on the hull).
+typedef struct {
+   Index u;             // u -> v is counter-clockwise around the inside triangle
+   Index v;
+   float enter;
+   float leave;
+} AlphaEdge;
+
+// Centered interval tree node: the edges whose [enter, leave) holds center,
+// sorted both ways, the others in the subtrees.
+typedef struct {
+   float center;
+   Index begin;         // by_enter / by_leave [begin .. end - 1]
+   Index end;
+   Index left;          // leave <= center, -1 when empty
+   Index right;         // enter > center, -1 when empty
+} AlphaNode;
+
+typedef struct {
+   AlphaNode* items;
+   Index count;
+   Index capacity;
+} AlphaNodes;
+
+// The alpha complex of a mesh, sorted once: the shape for alpha holds the
+// triangles with circumradius <= alpha. Valid until the mesh changes.
+typedef struct {
+   Index* triangles;    // by circumradius, smallest first
+   float* radii;        // of triangles[i]
+   Index triangle_count;
+   AlphaEdge* by_enter; // per node, ascending enter
+   AlphaEdge* by_leave; // per node, descending leave
+   Index edge_count;
+   AlphaNodes nodes;
+   Index root;
+} AlphaIndex;
+
+// Sorts triangles and border intervals, O(n log n). Triangles touching the
+// super triangle are never in.
+AlphaIndex delaunay_alpha_index(Delaunay* delaunay);
+void delaunay_alpha_free(AlphaIndex* alpha);
+
+// Number of triangles in the alpha shape: they are
+// alpha->triangles[0 .. count - 1]. O(log n).
+Index delaunay_alpha_triangles(AlphaIndex* alpha, float value);
+
+// The border of the alpha shape (the concave hull) as pairs u, v in
+// border, in no particular order but each one counter-clockwise around the
+// shape. O(log n + edges found). Returns the number of edges.
+Index delaunay_alpha_border(AlphaIndex* alpha, float value, Indices* border);
+
+#endif
@@ -0,0 +1,140 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "da.h"
+#include "delaunay.h"
+#include "parallel.h"
+#include "batch.h"
+
+typedef struct {
+   const PointSpan* spans;
+   Delaunay* meshes;
+   BatchResult* result;
+} BatchContext;
+
+// Triangulates one span and drops everything that touches the super triangle.
+void batch_build(void* ctx, int ix)
+{
+   BatchContext* bc = (BatchContext*)ctx;
+   const PointSpan* span = &bc->spans[ix];
+   Delaunay* d = &bc->meshes[ix];
+
+   *d = delaunay_init_engine(span->items, span->count, ENGINE_CAVITY);
+
+   while (d->currentpoint < d->points.count)
+   {
+      delaunay_step(d);
+   }
+
+   Index* remap = malloc(d->triangles.count * sizeof(Index));
+   Index kept = 0;
+   for (Index t = 0; t < d->triangles.count; ++t)
+   {
+      Triangle* tr = &TRIA(d, t);
+      remap[t] = (tr->ix1 < 3 || tr->ix2 < 3 || tr->ix3 < 3) ? -1 : kept++;
+   }
+
+   for (Index t = 0; t < d->triangles.count; ++t)
+   {
+      if (remap[t] == -1)
+      {
+         continue;
+      }
+
+      Triangle tr = TRIA(d, t);
+      tr.ix1 -= 3;
+      tr.ix2 -= 3;
+      tr.ix3 -= 3;
+      for (int n = 0; n < 3; ++n)
+      {
+         if (tr.neighbours[n] != -1)
+         {
+            tr.neighbours[n] = remap[tr.neighbours[n]];
+         }
+      }
+
+      TRIA(d, remap[t]) = tr;
+   }
+
+   d->triangles.count = kept;
+   free(remap);
+}
+
+// Copies one compacted span into its slot of the flat output.
+void batch_gather(void* ctx, int ix)
+{
+   BatchContext* bc = (BatchContext*)ctx;
+   BatchResult* r = bc->result;
+   Delaunay* d = &bc->meshes[ix];
+   Index point_base = r->point_offsets[ix];
+   Index triangle_base = r->triangle_offsets[ix];
+
+   memcpy(r->points.items + point_base, d->points.items + 3, (d->points.count - 3) * sizeof(Point));
+   memcpy(r->source.items + point_base, d->source.items, (d->points.count - 3) * sizeof(Index));
+
+   for (Index t = 0; t < d->triangles.count; ++t)
+   {
+      Triangle tr = TRIA(d, t);
+      tr.ix1 += point_base;
+      tr.ix2 += point_base;
+      tr.ix3 += point_base;
+      for (int n = 0; n < 3; ++n)
+      {
+         if (tr.neighbours[n] != -1)
+         {
+            tr.neighbours[n] += triangle_base;
+         }
+      }
+
+      r->triangles.items[triangle_base + t] = tr;
+   }
+
+   delaunay_free(d);
+}
+
+BatchResult delaunay_batch(const PointSpan* spans, int span_count, int thread_count)
+{
+   BatchResult r = { 0 };
+   r.span_count = span_count;
+   r.point_offsets = calloc(span_count + 1, sizeof(Index));
+   r.triangle_offsets = calloc(span_count + 1, sizeof(Index));
+
+   BatchContext bc = {
+      .spans = spans,
+      .meshes = calloc(span_count > 0 ? span_count : 1, sizeof(Delaunay)),
+      .result = &r
+   };
+
+   parallel_for(span_count, thread_count, batch_build, &bc);
+
+   for (Index s = 0; s < span_count; ++s)
+   {
+      r.point_offsets[s + 1] = r.point_offsets[s] + bc.meshes[s].points.count - 3;
+      r.triangle_offsets[s + 1] = r.triangle_offsets[s] + bc.meshes[s].triangles.count;
+   }
+
+   r.points.count = r.points.capacity = r.point_offsets[span_count];
+   r.source.count = r.source.capacity = r.point_offsets[span_count];
+   r.triangles.count = r.triangles.capacity = r.triangle_offsets[span_count];
+   r.points.items = malloc((r.points.count > 0 ? r.points.count : 1) * sizeof(Point));
+   r.source.items = malloc((r.source.count > 0 ? r.source.count : 1) * sizeof(Index));
+   r.triangles.items = malloc((r.triangles.count > 0 ? r.triangles.count : 1) * sizeof(Triangle));
+   assert(r.points.items != NULL && r.source.items != NULL && r.triangles.items != NULL && "Buy more RAM lol");
+
+   parallel_for(span_count, thread_count, batch_gather, &bc);
+
+   free(bc.meshes);
+   return r;
+}
+
+void batch_free(BatchResult* result)
+{
+   da_free(result->points);
+   da_free(result->source);
+   da_free(result->triangles);
+   free(result->point_offsets);
+   free(result->triangle_offsets);
+   *result = (BatchResult) { 0 };
+}
@@ -0,0 +1,31 @@
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+#include "delaunay.h"
+
+typedef struct {
+   const Point* items;
+   Index count;
+} PointSpan;
+
+// Triangulations of many independent point sets, stored back to back.
+// Span s owns points [point_offsets[s], point_offsets[s + 1]) and
+// triangles [triangle_offsets[s], triangle_offsets[s + 1]).
+// Vertex and neighbour indices are global indices into the flat arrays,
+// points are in the order they were inserted, super-triangle triangles
+// are left out. source[i] is the index of points.items[i] within its
+// span's input.
+typedef struct {
+   Points points;
+   Indices source;
+   Triangles triangles;
+   Index* point_offsets;
+   Index* triangle_offsets;
+   int span_count;
+} BatchResult;
+
+// thread_count <= 0 uses all online CPUs
+BatchResult delaunay_batch(const PointSpan* spans, int span_count, int thread_count);
+void batch_free(BatchResult* result);
+
+#endif
@@ -0,0 +1,181 @@
+// Times the insertion engines against each other on the same input.
+//
+// Also reports refinement throughput.
+//
+// usage: bench [point_count] [seed]
+//        bench --check [point_count] [seed] [min_points_per_second]
+//
+// --check builds every generator's input (see gen.h) with every engine,
+// runs delaunay_validate() and a brute-force empty-circle test on each
+// result, then delaunay_validate() again once finalized, and exits with 1
+// on any error or when the cavity engine is slower than
+// min_points_per_second. The duplicates input goes through
+// delaunay_init_dedupe(). make check runs it with a rate floor.
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "delaunay.h"
+#include "profile.h"
+#include "refine.h"
+#include "gen.h"
+
+#define WIDTH        800
+#define HEIGHT       600
+
+double now()
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void generate(GenKind kind, unsigned seed, Point* points, int point_count)
+{
+   Generator gen = gen_init(kind, seed, point_count, 0, 0, WIDTH, HEIGHT);
+   while (gen_next(&gen, points + gen.produced, 4096) > 0);
+}
+
+// O(n * t) reference: no inserted point may lie strictly inside any circumcircle
+int brute_force_check(Delaunay* d)
+{
+   int errors = 0;
+   for (Index t = 0; t < d->triangles.count; ++t)
+   {
+      Triangle* tr = &TRIA(d, t);
+      for (Index i = 0; i < d->currentpoint; ++i)
+      {
+         if (i != tr->ix1 && i != tr->ix2 && i != tr->ix3 && point_in_triangle_circle(d, tr, i)
+             && !cocircular_within_rounding(d, tr, i))
+         {
+            errors++;
+            break;
+         }
+      }
+   }
+
+   if (errors > 0)
+   {
+      printf("ERROR: %d triangles have a point inside their circle\n", errors);
+   }
+
+   return errors;
+}
+
+double run(const char* name, Engine engine, const Point* input, int point_count, bool dedupe, int* errors)
+{
+   Point* points = malloc(point_count * sizeof(Point));
+   memcpy(points, input, point_count * sizeof(Point));
+
+   double start = now();
+   Delaunay d = dedupe ? delaunay_init_dedupe(points, NULL, 0, point_count, engine, 0)
+                       : delaunay_init_engine(points, point_count, engine);
+   while (d.currentpoint < d.points.count)
+   {
+      delaunay_step(&d);
+   }
+   double elapsed = now() - start;
+
+   printf("%-8s %8d points %8" PRIidx " triangles %10.3f ms %12.0f points/s\n",
+          name, point_count, d.triangles.count, elapsed * 1000, point_count / elapsed);
+
+   if (errors != NULL)
+   {
+      *errors += delaunay_validate(&d);
+      *errors += brute_force_check(&d);
+
+      // the Hilbert renumbering must not change any answer
+      delaunay_finalize(&d);
+      *errors += delaunay_validate(&d);
+   }
+
+   delaunay_free(&d);
+   free(points);
+   return elapsed;
+}
+
+void run_refine(const Point* input, int point_count)
+{
+   Point* points = malloc(point_count * sizeof(Point));
+   memcpy(points, input, point_count * sizeof(Point));
+
+   Delaunay d = delaunay_init_engine(points, point_count, ENGINE_CAVITY);
+   while (d.currentpoint < d.points.count)
+   {
+      delaunay_step(&d);
+   }
+
+   RefineOptions options = { .min_angle = 25 };
+   double start = now();
+   Index inserted = delaunay_refine(&d, options);
+   double elapsed = now() - start;
+
+   printf("%-8s %8" PRIidx " points %8" PRIidx " triangles %10.3f ms %12.0f points/s\n",
+          "refine", inserted, d.triangles.count, elapsed * 1000, inserted / elapsed);
+
+   delaunay_free(&d);
+   free(points);
+}
+
+int check(int point_count, unsigned seed, float min_rate)
+{
+   int errors = 0;
+   Point* points = malloc(point_count * sizeof(Point));
+
+   for (int kind = 0; kind < GEN_COUNT; ++kind)
+   {
+      printf("-- %s\n", gen_name(kind));
+      generate(kind, seed, points, point_count);
+
+      // duplicate points would end up as zero-area triangles
+      bool dedupe = kind == GEN_DUPLICATES;
+      run("flip", ENGINE_FLIP, points, point_count, dedupe, &errors);
+      double cavity = run("cavity", ENGINE_CAVITY, points, point_count, dedupe, &errors);
+
+      if (point_count / cavity < min_rate)
+      {
+         printf("ERROR: cavity engine below %.0f points/s\n", min_rate);
+         errors++;
+      }
+   }
+
+   free(points);
+   printf("%s: %d errors\n", errors == 0 ? "PASS" : "FAIL", errors);
+   return errors == 0 ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+   bool check_mode = argc > 1 && strcmp(argv[1], "--check") == 0;
+   if (check_mode)
+   {
+      argc--;
+      argv++;
+   }
+
+   int point_count = argc > 1 ? atoi(argv[1]) : (check_mode ? 200 : 500);
+   unsigned seed = argc > 2 ? (unsigned)atoi(argv[2]) : 13;
+   float min_rate = argc > 3 ? atof(argv[3]) : 0;
+
+   if (check_mode)
+   {
+      return check(point_count, seed, min_rate);
+   }
+
+   Point* points = malloc(point_count * sizeof(Point));
+   generate(GEN_UNIFORM, seed, points, point_count);
+
+   double flip = run("flip", ENGINE_FLIP, points, point_count, false, NULL);
+   double cavity = run("cavity", ENGINE_CAVITY, points, point_count, false, NULL);
+   printf("cavity speedup: %.2fx\n", flip / cavity);
+   run_refine(points, point_count);
+
+   // only with -DDELAUNAY_PROFILE
+   PROFILE_DUMP("bench_trace.json");
+
+   free(points);
+   return 0;
+}
@@ -0,0 +1,252 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "da.h"
+#include "delaunay.h"
+#include "checkpoint.h"
+
+#define CHECKPOINT_MAGIC "DLNYCKP6"
+#define CHECKPOINT_BUFFER (4 << 20)
+
+typedef struct {
+   char magic[8];
+   int point_size;
+   int triangle_size;
+   int index_size;
+   int engine;
+   int channels;
+   int finalized;
+   int64_t hull_hint;
+   int64_t locate_hint;
+   int64_t currentpoint;
+   int64_t dropped;
+   int64_t point_count;
+   int64_t triangle_count;
+   int64_t stack_count;
+   int64_t source_count;
+   int64_t vertex_count;
+   int64_t attribute_count;
+} CheckpointHeader;
+
+bool delaunay_checkpoint(Delaunay* delaunay, const char* path)
+{
+   char temp[1024];
+   snprintf(temp, sizeof(temp), "%s.tmp", path);
+
+   FILE* f = fopen(temp, "wb");
+   if (f == NULL)
+   {
+      printf("ERROR: can't write checkpoint %s\n", temp);
+      return false;
+   }
+
+   // few, large writes
+   setvbuf(f, NULL, _IOFBF, CHECKPOINT_BUFFER);
+
+   CheckpointHeader header = {
+      .point_size = sizeof(Point),
+      .triangle_size = sizeof(Triangle),
+      .index_size = sizeof(Index),
+      .engine = delaunay->engine,
+      .channels = delaunay->channels,
+      .finalized = delaunay->finalized,
+      .hull_hint = delaunay->hull_hint,
+      .locate_hint = delaunay->locate_hint,
+      .currentpoint = delaunay->currentpoint,
+      .dropped = delaunay->dropped,
+      .point_count = delaunay->points.count,
+      .triangle_count = delaunay->triangles.count,
+      .stack_count = delaunay->stack.count,
+      .source_count = delaunay->source.count,
+      .vertex_count = delaunay->vertex.count,
+      .attribute_count = delaunay->attributes.count
+   };
+   memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+
+   bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+   ok = ok && fwrite(delaunay->points.items, sizeof(Point), header.point_count, f) == (size_t)header.point_count;
+   ok = ok && fwrite(delaunay->triangles.items, sizeof(Triangle), header.triangle_count, f) == (size_t)header.triangle_count;
+   ok = ok && fwrite(delaunay->stack.items, sizeof(Index), header.stack_count, f) == (size_t)header.stack_count;
+   ok = ok && fwrite(delaunay->source.items, sizeof(Index), header.source_count, f) == (size_t)header.source_count;
+   ok = ok && fwrite(delaunay->vertex.items, sizeof(Index), header.vertex_count, f) == (size_t)header.vertex_count;
+   ok = ok && fwrite(delaunay->attributes.items, sizeof(float), header.attribute_count, f) == (size_t)header.attribute_count;
+   ok = ok && fflush(f) == 0 && fsync(fileno(f)) == 0;
+   ok = (fclose(f) == 0) && ok;
+
+   if (!ok || rename(temp, path) != 0)
+   {
+      printf("ERROR: writing checkpoint %s failed\n", path);
+      remove(temp);
+      return false;
+   }
+
+   return true;
+}
+
+bool read_items(FILE* f, void** items, Index* count, Index* capacity, size_t size, int64_t wanted)
+{
+   *items = malloc((wanted > 0 ? wanted : 1) * size);
+   if (*items == NULL)
+   {
+      return false;
+   }
+
+   *count = (Index)wanted;
+   *capacity = wanted > 0 ? (Index)wanted : 1;
+   return fread(*items, size, wanted, f) == (size_t)wanted;
+}
+
+bool fits_index(int64_t count)
+{
+   return count >= 0 && (int64_t)(Index)count == count;
+}
+
+// The counts and hints, before anything is allocated from them.
+bool header_valid(const CheckpointHeader* h)
+{
+   Index first = h->finalized ? 0 : 3;
+   return fits_index(h->point_count) && fits_index(h->triangle_count) && fits_index(h->stack_count)
+       && fits_index(h->source_count) && fits_index(h->vertex_count) && fits_index(h->attribute_count)
+       && (h->engine == ENGINE_FLIP || h->engine == ENGINE_CAVITY)
+       && (h->finalized == 0 || h->finalized == 1)
+       && h->channels >= 0
+       && h->attribute_count == h->point_count * h->channels
+       && h->point_count >= first
+       && h->currentpoint >= first && h->currentpoint <= h->point_count
+       && (!h->finalized || h->currentpoint == h->point_count)
+       && fits_index(h->dropped)
+       && h->source_count <= h->point_count - first
+       && h->hull_hint >= -1 && h->hull_hint < h->triangle_count
+       && h->locate_hint >= -1 && h->locate_hint < h->triangle_count;
+}
+
+// Every index stored in the arrays points into them, so that stepping on
+// never reads or writes out of bounds.
+bool content_valid(Delaunay* d)
+{
+   Index first = d->finalized ? 0 : 3;
+   for (Index t = 0; t < d->triangles.count; ++t)
+   {
+      Triangle* tr = &TRIA(d, t);
+      Index ix[3] = { tr->ix1, tr->ix2, tr->ix3 };
+      for (int k = 0; k < 3; ++k)
+      {
+         if (ix[k] < 0 || ix[k] >= d->currentpoint
+             || tr->neighbours[k] < -1 || tr->neighbours[k] >= d->triangles.count)
+         {
+            return false;
+         }
+      }
+   }
+
+   for (Index i = 0; i < d->stack.count; ++i)
+   {
+      if (d->stack.items[i] < 0 || d->stack.items[i] >= d->triangles.count)
+      {
+         return false;
+      }
+   }
+
+   for (Index i = 0; i < d->source.count; ++i)
+   {
+      if (d->source.items[i] < -1)
+      {
+         return false;
+      }
+   }
+
+   for (Index i = 0; i < d->vertex.count; ++i)
+   {
+      if (d->vertex.items[i] < first || d->vertex.items[i] >= d->points.count)
+      {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+bool delaunay_resume(const char* path, Delaunay* delaunay)
+{
+   FILE* f = fopen(path, "rb");
+   if (f == NULL)
+   {
+      printf("ERROR: can't open checkpoint %s\n", path);
+      return false;
+   }
+
+   setvbuf(f, NULL, _IOFBF, CHECKPOINT_BUFFER);
+
+   CheckpointHeader header;
+   if (fread(&header, sizeof(header), 1, f) != 1
+       || memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0
+       || header.point_size != sizeof(Point)
+       || header.triangle_size != sizeof(Triangle)
+       || header.index_size != sizeof(Index))
+   {
+      printf("ERROR: %s is not a checkpoint of this build\n", path);
+      fclose(f);
+      return false;
+   }
+
+   if (!header_valid(&header))
+   {
+      printf("ERROR: checkpoint %s is corrupt\n", path);
+      fclose(f);
+      return false;
+   }
+
+   Delaunay d = { 0 };
+   d.engine = header.engine;
+   d.channels = header.channels;
+   d.finalized = header.finalized;
+   d.hull_hint = (Index)header.hull_hint;
+   d.locate_hint = (Index)header.locate_hint;
+   d.currentpoint = (Index)header.currentpoint;
+   d.dropped = (Index)header.dropped;
+
+   bool ok = read_items(f, (void**)&d.points.items, &d.points.count, &d.points.capacity, sizeof(Point), header.point_count);
+   ok = ok && read_items(f, (void**)&d.triangles.items, &d.triangles.count, &d.triangles.capacity, sizeof(Triangle), header.triangle_count);
+   ok = ok && read_items(f, (void**)&d.stack.items, &d.stack.count, &d.stack.capacity, sizeof(Index), header.stack_count);
+   ok = ok && read_items(f, (void**)&d.source.items, &d.source.count, &d.source.capacity, sizeof(Index), header.source_count);
+   ok = ok && read_items(f, (void**)&d.vertex.items, &d.vertex.count, &d.vertex.capacity, sizeof(Index), header.vertex_count);
+   ok = ok && read_items(f, (void**)&d.attributes.items, &d.attributes.count, &d.attributes.capacity, sizeof(float), header.attribute_count);
+   fclose(f);
+
+   if (!ok)
+   {
+      printf("ERROR: checkpoint %s is truncated\n", path);
+      delaunay_free(&d);
+      return false;
+   }
+
+   if (!content_valid(&d))
+   {
+      printf("ERROR: checkpoint %s is corrupt\n", path);
+      delaunay_free(&d);
+      return false;
+   }
+
+   delaunay_free(delaunay);
+   *delaunay = d;
+   return true;
+}
+
+void delaunay_build(Delaunay* delaunay, const char* path, int interval)
+{
+   Index last = delaunay->currentpoint;
+   while (delaunay->currentpoint < delaunay->points.count)
+   {
+      delaunay_step(delaunay);
+      if (interval > 0 && delaunay->currentpoint - last >= interval)
+      {
+         delaunay_checkpoint(delaunay, path);
+         last = delaunay->currentpoint;
+      }
+   }
+
+   delaunay_checkpoint(delaunay, path);
+}
@@ -0,0 +1,23 @@
+#ifndef _CHECKPOINT_H_
+#define _CHECKPOINT_H_
+
+#include <stdbool.h>
+#include "delaunay.h"
+
+// Saves the build state (points, triangles, currentpoint, the flip
+// work-list, the source and vertex maps and the attributes) to path. The
+// file is written next to it first and renamed into place, so a crash never
+// leaves a half-written checkpoint behind.
+bool delaunay_checkpoint(Delaunay* delaunay, const char* path);
+
+// Loads a checkpoint written by delaunay_checkpoint(). delaunay_step()
+// continues with the saved currentpoint. Files whose counts or indices
+// don't add up are rejected. *delaunay must be zeroed or a valid instance,
+// it is freed and replaced on success.
+bool delaunay_resume(const char* path, Delaunay* delaunay);
+
+// Steps until all points are inserted, writing a checkpoint every
+// interval points and once more at the end.
+void delaunay_build(Delaunay* delaunay, const char* path, int interval);
+
+#endif
@@ -10,35 +10,40 @@
 // Initial capacity of a dynamic array
 #define DA_INIT_CAP 256
 
+// True while doubling the capacity can't overflow its (signed) type
+#define DA_CAN_GROW(da) ((size_t)(da)->capacity < ((size_t)1 << (sizeof((da)->capacity) * 8 - 2)))
+
 // Append an item to a dynamic array
-#define da_append(da, item)                                                              \
-    do {                                                                                 \
-        if ((da)->count >= (da)->capacity) {                                             \
-            (da)->capacity = (da)->capacity == 0 ? DA_INIT_CAP : (da)->capacity*2;       \
-            (da)->items = DA_REALLOC((da)->items, (da)->capacity*sizeof(*(da)->items));  \
-            DA_ASSERT((da)->items != NULL && "Buy more RAM lol");                        \
-        }                                                                                \
-                                                                                         \
-        (da)->items[(da)->count++] = (item);                                             \
+#define da_append(da, item)                                                                     \
+    do {                                                                                        \
+        if ((da)->count >= (da)->capacity) {                                                    \
+            DA_ASSERT(DA_CAN_GROW(da) && "Count type too small");                               \
+            (da)->capacity = (da)->capacity == 0 ? DA_INIT_CAP : (da)->capacity*2;              \
+            (da)->items = DA_REALLOC((da)->items, (size_t)(da)->capacity*sizeof(*(da)->items)); \
+            DA_ASSERT((da)->items != NULL && "Buy more RAM lol");                               \
+        }                                                                                       \
+                                                                                                \
+        (da)->items[(da)->count++] = (item);                                                    \
     } while (0)
 
 #define da_free(da) DA_FREE((da).items)
 
 // Append several items to a dynamic array
-#define da_append_many(da, new_items, new_items_count)                                      \
-    do {                                                                                    \
-        if ((da)->count + new_items_count > (da)->capacity) {                               \
-            if ((da)->capacity == 0) {                                                      \
-                (da)->capacity = DA_INIT_CAP;                                               \
-            }                                                                               \
-            while ((da)->count + new_items_count > (da)->capacity) {                        \
-                (da)->capacity *= 2;                                                        \
-            }                                                                               \
-            (da)->items = DA_REALLOC((da)->items, (da)->capacity*sizeof(*(da)->items));     \
-            DA_ASSERT((da)->items != NULL && "Buy more RAM lol");                           \
-        }                                                                                   \
-        memcpy((da)->items + (da)->count, new_items, new_items_count*sizeof(*(da)->items)); \
-        (da)->count += new_items_count;                                                     \
+#define da_append_many(da, new_items, new_items_count)                                                \
+    do {                                                                                              \
+        if ((da)->count + new_items_count > (da)->capacity) {                                         \
+            if ((da)->capacity == 0) {                                                                \
+                (da)->capacity = DA_INIT_CAP;                                                         \
+            }                                                                                         \
+            while ((da)->count + new_items_count > (da)->capacity) {                                  \
+                DA_ASSERT(DA_CAN_GROW(da) && "Count type too small");                                 \
+                (da)->capacity *= 2;                                                                  \
+            }                                                                                         \
+            (da)->items = DA_REALLOC((da)->items, (size_t)(da)->capacity*sizeof(*(da)->items));       \
+            DA_ASSERT((da)->items != NULL && "Buy more RAM lol");                                     \
+        }                                                                                             \
+        memcpy((da)->items + (da)->count, new_items, (size_t)(new_items_count)*sizeof(*(da)->items)); \
+        (da)->count += new_items_count;                                                               \
     } while (0)
 
 
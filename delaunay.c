@@ -11,13 +11,39 @@
 #include "da.h"
 #include "utils.h"
 #include "delaunay.h"
+#include "profile.h"
 
 // private /////////////////////////////////////////////////////////
-int block_index(const Point* p);
-int sort_by_region(const void* aa, const void* bb);
+typedef struct {
+   int64_t key;
+   Index index;
+} SortKey;
+
+// Maps the bounds of the points onto the 65536 x 65536 Hilbert grid.
+typedef struct {
+   float minx;
+   float miny;
+   float scalex;
+   float scaley;
+} CurveFrame;
+
+typedef struct {
+   int64_t key;
+   Point p;
+   Index index;
+} PointKey;
+
+Delaunay init_points(const Point* points, const float* attributes, int channels, Index point_count, Engine engine, bool dedupe, float tolerance);
+Index dedupe_points(const Point* points, Index point_count, float tolerance, const CurveFrame* frame, SortKey* keys, Indices* vertex);
+Point snap_point(Point p, float tolerance);
+void drop_point(Delaunay* delaunay, Index ix, Index duplicate);
+Index has_duplicate(Delaunay* delaunay, Triangle* tr, Index point_ix);
+CurveFrame curve_frame(float minx, float miny, float maxx, float maxy);
+int64_t curve_key(const CurveFrame* frame, float x, float y);
+int sort_by_key(const void* aa, const void* bb);
+int sort_by_key_point(const void* aa, const void* bb);
 
 bool point_in_triangle(Point* p, Point* a, Point* b, Point* c);
-bool point_in_circle(Point p, Circle c);
 
 Line linear_eq(Point* p1, Point* p2);
 Line perp_line(Point* p, Line* l);
@@ -25,45 +51,38 @@ Point crossing_point(Line* l1, Line* l2);
 Circle circle_from_triangle(Point* a, Point* b, Point* c);
 ////////////////////////////////////////////////////////////////////
 
-#define MAX_STACK 100
-int stack[MAX_STACK];
-int stack_pointer = 0;
+// The flip work-list lives in the Delaunay instance, so separate
+// instances can be built on separate threads.
 
-void stack_push(int value)
+void stack_push(Delaunay* delaunay, Index value)
 {
    if (value == -1)
    {
       return;
    }
    
-   for (int i = 0; i < stack_pointer; ++i)
+   for (Index i = 0; i < delaunay->stack.count; ++i)
    {
-      if (stack[i] == value)
+      if (delaunay->stack.items[i] == value)
       {
          return;
       }
    }
    
-   if (stack_pointer >= MAX_STACK)
-   {
-      printf("ERROR: stack too small\n");
-      return;
-   }
-   
-   stack[stack_pointer++] = value;
+   da_append(&delaunay->stack, value);
 }
 
-int stack_pop()
+Index stack_pop(Delaunay* delaunay)
 {
-   return stack[--stack_pointer];
+   return delaunay->stack.items[--delaunay->stack.count];
 }
 
-void stack_print()
+void stack_print(Delaunay* delaunay)
 {
    printf("Stack: ");
-   for (int i = 0; i < stack_pointer; ++i)
+   for (Index i = 0; i < delaunay->stack.count; ++i)
    {
-      printf("%d ", stack[i]);
+      printf("%" PRIidx " ", delaunay->stack.items[i]);
    }
    
    printf("\n");
@@ -71,33 +90,155 @@ void stack_print()
 
 ////////////////////////////////////////////////////////////////////
 
+Index grid_cell(LocateGrid* grid, float x, float y)
+{
+   int column = (int)((x - grid->minx) / grid->cell_size);
+   int row = (int)((y - grid->miny) / grid->cell_size);
+   column = column < 0 ? 0 : (column >= grid->columns ? grid->columns - 1 : column);
+   row = row < 0 ? 0 : (row >= grid->rows ? grid->rows - 1 : row);
+   return (Index)row * grid->columns + column;
+}
+
+// The hint of the cell p is in or, when that one is still empty, of the
+// nearest non-empty cell within a few rings around it. -1 if none.
+Index grid_hint(LocateGrid* grid, float x, float y)
+{
+   Index cell = grid_cell(grid, x, y);
+   int column = (int)(cell % grid->columns);
+   int row = (int)(cell / grid->columns);
+   for (int ring = 0; ring <= 3; ++ring)
+   {
+      for (int r = row - ring; r <= row + ring; ++r)
+      {
+         for (int c = column - ring; c <= column + ring; ++c)
+         {
+            bool edge = r == row - ring || r == row + ring || c == column - ring || c == column + ring;
+            if (!edge || r < 0 || r >= grid->rows || c < 0 || c >= grid->columns)
+            {
+               continue;
+            }
+
+            Index hint = grid->cells[(Index)r * grid->columns + c];
+            if (hint != -1)
+            {
+               return hint;
+            }
+         }
+      }
+   }
+
+   return -1;
+}
+
+// Called for every triangle that is (re)written. Any triangle that loses
+// a super-triangle point hands it to another rewritten triangle, so the
+// hull hint always ends up on the ring around the super triangle.
+// The locate hints only need to be some triangle nearby, stale is fine.
+void track_triangle(Delaunay* delaunay, Index t)
+{
+   Triangle* tr = &TRIA(delaunay, t);
+   delaunay->locate_hint = t;
+
+   if (tr->ix1 < 3 || tr->ix2 < 3 || tr->ix3 < 3)
+   {
+      delaunay->hull_hint = t;
+   }
+   else if (delaunay->grid.cells != NULL)
+   {
+      float cx = ((float)POINT(delaunay, tr->ix1).x + POINT(delaunay, tr->ix2).x + POINT(delaunay, tr->ix3).x) / 3;
+      float cy = ((float)POINT(delaunay, tr->ix1).y + POINT(delaunay, tr->ix2).y + POINT(delaunay, tr->ix3).y) / 3;
+      delaunay->grid.cells[grid_cell(&delaunay->grid, cx, cy)] = t;
+   }
+}
+
+////////////////////////////////////////////////////////////////////
+
+
+Delaunay delaunay_init(const Point* points, Index point_count)
+{
+   return delaunay_init_engine(points, point_count, ENGINE_FLIP);
+}
+
+Delaunay delaunay_init_engine(const Point* points, Index point_count, Engine engine)
+{
+   return delaunay_init_attributes(points, NULL, 0, point_count, engine);
+}
+
+Delaunay delaunay_init_attributes(const Point* points, const float* attributes, int channels, Index point_count, Engine engine)
+{
+   return init_points(points, attributes, channels, point_count, engine, false, 0);
+}
+
+Delaunay delaunay_init_dedupe(const Point* points, const float* attributes, int channels, Index point_count, Engine engine, float tolerance)
+{
+   return init_points(points, attributes, channels, point_count, engine, true, tolerance);
+}
 
-Delaunay delaunay_init(Point* points, int point_count)
+Delaunay init_points(const Point* points, const float* attributes, int channels, Index point_count, Engine engine, bool dedupe, float tolerance)
 {
    #define BIG 2000
    Delaunay d = { 0 };
    d.points = (Points) { 0 };
    d.triangles = (Triangles) { 0 };
+   d.engine = engine;
+   d.channels = attributes != NULL ? channels : 0;
 
-   /*float minx = 1000000;
-   float maxx = -1000000;
+   float minx = FLT_MAX;
+   float maxx = -FLT_MAX;
    float miny = minx;
    float maxy = maxx;
 
-   for (int i = 0; i < point_count; ++i)
+   for (Index i = 0; i < point_count; ++i)
    {
       minx = min(points[i].x, minx);
       maxx = max(points[i].x, maxx);
       miny = min(points[i].y, miny);
       maxy = max(points[i].y, maxy);
-   }*/
+   }
 
-   qsort(points, point_count, sizeof(Point), sort_by_region);
+   if (point_count == 0)
+   {
+      minx = miny = maxx = maxy = 0;
+   }
 
-   // big triangle:
-   Point b0 = { .x = BIG / 2, .y = -BIG };
-   Point b1 = { .x = BIG, .y = BIG };
-   Point b2 = { .x = -BIG, .y = BIG };
+#ifdef DELAUNAY_INT_COORDS
+   assert(minx >= -DELAUNAY_INPUT_MAX && maxx <= DELAUNAY_INPUT_MAX
+          && miny >= -DELAUNAY_INPUT_MAX && maxy <= DELAUNAY_INPUT_MAX
+          && "integer coordinates beyond DELAUNAY_INPUT_MAX");
+#endif
+
+   // insertion order: along a Hilbert curve over the bounds, so every point
+   // lands next to the one before, ties in input order (by position when
+   // deduplicating, see dedupe_points()). The caller's array is left
+   // alone, source remembers where every point came from.
+   PROFILE_BEGIN("sort");
+   CurveFrame frame = curve_frame(minx, miny, maxx, maxy);
+   Index kept = point_count;
+   SortKey* keys = malloc((point_count > 0 ? point_count : 1) * sizeof(SortKey));
+   assert(keys != NULL && "Buy more RAM lol");
+   if (dedupe)
+   {
+      kept = dedupe_points(points, point_count, tolerance, &frame, keys, &d.vertex);
+   }
+   else
+   {
+      for (Index i = 0; i < point_count; ++i)
+      {
+         keys[i] = (SortKey) { .key = curve_key(&frame, points[i].x, points[i].y), .index = i };
+      }
+      qsort(keys, point_count, sizeof(SortKey), sort_by_key);
+   }
+   PROFILE_END();
+
+   // big triangle, around the bounds of the points, at least as big as the window
+   // (with integer coordinates, see DELAUNAY_INPUT_MAX)
+   float extent = max(maxx - minx, maxy - miny);
+   float size = max(extent * 4, BIG);
+   float cx = (minx + maxx) / 2;
+   float cy = (miny + maxy) / 2;
+   Point b0 = { .x = cx, .y = cy - 2 * size };
+   Point b1 = { .x = cx + 2 * size, .y = cy + size };
+   Point b2 = { .x = cx - 2 * size, .y = cy + size };
    //Point b0 = { .x = 400, .y = 10 };
    //Point b1 = { .x = 780, .y = 570 };
    //Point b2 = { .x = 10, .y = 580 };
@@ -114,21 +255,81 @@ Delaunay delaunay_init(Point* points, int point_count)
    da_append(&d.triangles, big);
    d.currentpoint = 3;
 
-   for (int i = 0; i < point_count; ++i)
+   for (Index i = 0; i < 3 * d.channels; ++i)
+   {
+      da_append(&d.attributes, 0.0f);
+   }
+
+   for (Index i = 0; i < kept; ++i)
    {
-      da_append(&d.points, points[i]);
+      Point p = points[keys[i].index];
+      da_append(&d.points, dedupe && tolerance > 0 ? snap_point(p, tolerance) : p);
+      da_append(&d.source, keys[i].index);
+      for (int c = 0; c < d.channels; ++c)
+      {
+         da_append(&d.attributes, attributes[keys[i].index * channels + c]);
+      }
    }
 
+   free(keys);
    return d;
 }
 
+Point snap_point(Point p, float tolerance)
+{
+   return (Point) {
+      .x = (Coord)(floor((double)p.x / tolerance + 0.5) * tolerance),
+      .y = (Coord)(floor((double)p.y / tolerance + 0.5) * tolerance)
+   };
+}
+
+// Sorts like init, ties by position, so that points that are equal once
+// snapped end up next to each other, and keeps the first of every run in
+// keys. vertex gets the mesh point of every input point. Returns how many
+// were kept.
+Index dedupe_points(const Point* points, Index point_count, float tolerance, const CurveFrame* frame, SortKey* keys, Indices* vertex)
+{
+   PointKey* sorted = malloc((point_count > 0 ? point_count : 1) * sizeof(PointKey));
+   Index* items = malloc((point_count > 0 ? point_count : 1) * sizeof(Index));
+   assert(sorted != NULL && items != NULL && "Buy more RAM lol");
+   for (Index i = 0; i < point_count; ++i)
+   {
+      Point p = tolerance > 0 ? snap_point(points[i], tolerance) : points[i];
+      sorted[i] = (PointKey) { .key = curve_key(frame, p.x, p.y), .p = p, .index = i };
+   }
+   qsort(sorted, point_count, sizeof(PointKey), sort_by_key_point);
+
+   Index kept = 0;
+   for (Index i = 0; i < point_count; ++i)
+   {
+      if (i == 0 || sorted[i].p.x != sorted[i - 1].p.x || sorted[i].p.y != sorted[i - 1].p.y)
+      {
+         keys[kept++] = (SortKey) { .key = sorted[i].key, .index = sorted[i].index };
+      }
+
+      items[sorted[i].index] = kept - 1 + 3;
+   }
+
+   free(sorted);
+   *vertex = (Indices) { .items = items, .count = point_count, .capacity = point_count > 0 ? point_count : 1 };
+   return kept;
+}
+
 void delaunay_free(Delaunay* delaunay)
 {
    da_free(delaunay->triangles);
    da_free(delaunay->points);
+   da_free(delaunay->stack);
+   da_free(delaunay->cavity);
+   da_free(delaunay->boundary);
+   da_free(delaunay->source);
+   da_free(delaunay->vertex);
+   da_free(delaunay->attributes);
+   free(delaunay->grid.cells);
+   *delaunay = (Delaunay) { 0 };
 }
 
-void add_neightbour(Triangle* tr, int n)
+void add_neightbour(Triangle* tr, Index n)
 {
    if (tr->neighbours[0] == -1)
    {
@@ -177,7 +378,7 @@ bool has_2_points_in_common(Triangle* a, Triangle* b)
    return (in_common == 2);
 }
 
-void calculate_circle(Delaunay* delaunay, int triangle_ix)
+void calculate_circle(Delaunay* delaunay, Index triangle_ix)
 {
    Triangle* tr = &TRIA(delaunay, triangle_ix);
    
@@ -187,7 +388,7 @@ void calculate_circle(Delaunay* delaunay, int triangle_ix)
    tr->circle = circle_from_triangle(a, b, c);
 }
 
-void calculate_neighbours(Delaunay* delaunay, int triangle_ix)
+void calculate_neighbours(Delaunay* delaunay, Index triangle_ix)
 {
    //printf("Calc neighbours for triangle #%d\n", triangle_ix);
 
@@ -195,7 +396,7 @@ void calculate_neighbours(Delaunay* delaunay, int triangle_ix)
    TRIA(delaunay, triangle_ix).neighbours[1] = -1;
    TRIA(delaunay, triangle_ix).neighbours[2] = -1;
 
-   for (int t = 0; t < delaunay->triangles.count; ++t)
+   for (Index t = 0; t < delaunay->triangles.count; ++t)
    {
       if (t == triangle_ix)
       {
@@ -213,7 +414,7 @@ void calculate_neighbours(Delaunay* delaunay, int triangle_ix)
    //                               TRIA(delaunay, triangle_ix).neighbours[2]);
 }
 
-void common_points(Triangle* t1, Triangle* t2, int* common1, int* common2)
+void common_points(Triangle* t1, Triangle* t2, Index* common1, Index* common2)
 {
    *common1 = -1;
    *common2 = -1;
@@ -240,7 +441,7 @@ void common_points(Triangle* t1, Triangle* t2, int* common1, int* common2)
    }
 }
 
-int not_common_point(Triangle* t1, Triangle* t2)
+Index not_common_point(Triangle* t1, Triangle* t2)
 {
    if (t2->ix1 != t1->ix1 && t2->ix1 != t1->ix2 && t2->ix1 != t1->ix3)
    {
@@ -260,7 +461,7 @@ int not_common_point(Triangle* t1, Triangle* t2)
    return -1;
 }
 
-void replace_point(Triangle *t, int from, int to)
+void replace_point(Triangle *t, Index from, Index to)
 {
    if (t->ix1 == from)
    {
@@ -285,10 +486,10 @@ void swap_triangles(Triangle* t1, Triangle* t2)
 {
    //printf("Swapping T1: %d %d %d  with T2: %d %d %d\n", t1->ix1, t1->ix2, t1->ix3, t2->ix1, t2->ix2, t2->ix3);
 
-   int nc1 = not_common_point(t1, t2);
-   int nc2 = not_common_point(t2, t1);
+   Index nc1 = not_common_point(t1, t2);
+   Index nc2 = not_common_point(t2, t1);
 
-   int c1, c2;
+   Index c1, c2;
    common_points(t1, t2, &c1, &c2);
 
    //printf("Common: %d and %d    Not Common: %d and %d\n", c1, c2, nc1, nc2);
@@ -301,15 +502,15 @@ void swap_triangles(Triangle* t1, Triangle* t2)
 
 bool process_stack(Delaunay* delaunay)
 {
-   if (stack_pointer == 0)
+   if (delaunay->stack.count == 0)
    {
       return false;
    }
 
    //printf("Process Stack --------------\n");
 
-   stack_pointer--;
-   Triangle* tr = &TRIA(delaunay, stack[stack_pointer]);
+   Index tix = stack_pop(delaunay);
+   Triangle* tr = &TRIA(delaunay, tix);
    
    // for all neighbours of this triangle, check if the third point is inside this triangles circle
    // if so, swap the coeection from the common points to the not-common points and add all neightbours to the stack 
@@ -321,18 +522,18 @@ bool process_stack(Delaunay* delaunay)
          continue;
       }
       
-      printf("Neighbour: %d\n", tr->neighbours[n]);
+      //printf("Neighbour: %d\n", tr->neighbours[n]);
 
       Triangle* ntr = &TRIA(delaunay, tr->neighbours[n]);
 
-      int pix = not_common_point(tr, ntr);
+      Index pix = not_common_point(tr, ntr);
       if (pix == -1)
       {
-         printf("Error: no non-common point found between T #%d and #%d \n", stack[stack_pointer], tr->neighbours[n]);
+         printf("Error: no non-common point found between T #%" PRIidx " and #%" PRIidx " \n", tix, tr->neighbours[n]);
          return false;
       }
 
-      if (!point_in_circle(POINT(delaunay, pix), tr->circle))
+      if (!point_in_triangle_circle(delaunay, tr, pix))
       {
          continue;
       }
@@ -343,9 +544,12 @@ bool process_stack(Delaunay* delaunay)
          Triangle* tt = &TRIA(delaunay, tria);
          printf("T%d: %d %d %d\n", tria, tt->ix1, tt->ix2, tt->ix3);
       }*/
-      printf("Swapping %d and %d\n", stack[stack_pointer], tr->neighbours[n]);
+      //printf("Swapping %d and %d\n", tix, tr->neighbours[n]);
 
+      Index nix = tr->neighbours[n];
       swap_triangles(ntr, tr);
+      track_triangle(delaunay, tix);
+      track_triangle(delaunay, nix);
 
       /*printf("Swapped\n");
       for (int tria = 0; tria < delaunay->triangles.count; ++tria)
@@ -354,22 +558,22 @@ bool process_stack(Delaunay* delaunay)
          printf("T%d: %d %d %d\n", tria, tt->ix1, tt->ix2, tt->ix3);
       }*/
 
-      for (int i = 0; i < delaunay->triangles.count; ++i)
+      for (Index i = 0; i < delaunay->triangles.count; ++i)
       {
          calculate_neighbours(delaunay, i);
          calculate_circle(delaunay, i);
       }
 
-      stack_push(tr->neighbours[0]);
-      stack_push(tr->neighbours[1]);
-      stack_push(tr->neighbours[2]);
-      stack_push(ntr->neighbours[0]);
-      stack_push(ntr->neighbours[1]);
-      stack_push(ntr->neighbours[2]);
+      stack_push(delaunay, tr->neighbours[0]);
+      stack_push(delaunay, tr->neighbours[1]);
+      stack_push(delaunay, tr->neighbours[2]);
+      stack_push(delaunay, ntr->neighbours[0]);
+      stack_push(delaunay, ntr->neighbours[1]);
+      stack_push(delaunay, ntr->neighbours[2]);
       break;
    }
 
-   for (int i = 0; i < delaunay->triangles.count; ++i)
+   for (Index i = 0; i < delaunay->triangles.count; ++i)
    {
       calculate_neighbours(delaunay, i);
       calculate_circle(delaunay, i);
@@ -378,137 +582,952 @@ bool process_stack(Delaunay* delaunay)
    return true;
 }
 
-void delaunay_step(Delaunay* delaunay)
+void delaunay_use_grid(Delaunay* delaunay, Index cell_count)
 {
-   if (delaunay->currentpoint >= delaunay->points.count)
+   LocateGrid* grid = &delaunay->grid;
+   free(grid->cells);
+   *grid = (LocateGrid) { 0 };
+
+   Index first = delaunay->finalized ? 0 : 3;
+   if (delaunay->finalized || delaunay->points.count <= first)
    {
-      // printf("No steps left\n");
       return;
    }
 
-   bool found = false;
-   for (int t = 0; t < delaunay->triangles.count; ++t)
+   float maxx = -FLT_MAX;
+   float maxy = -FLT_MAX;
+   grid->minx = FLT_MAX;
+   grid->miny = FLT_MAX;
+   for (Index i = first; i < delaunay->points.count; ++i)
+   {
+      grid->minx = fminf(POINT(delaunay, i).x, grid->minx);
+      grid->miny = fminf(POINT(delaunay, i).y, grid->miny);
+      maxx = fmaxf(POINT(delaunay, i).x, maxx);
+      maxy = fmaxf(POINT(delaunay, i).y, maxy);
+   }
+
+   if (cell_count <= 0)
+   {
+      cell_count = delaunay->points.count - first;
+   }
+
+   // square cells, as many as asked for over the bounding box
+   float width = fmaxf(maxx - grid->minx, 1e-6f);
+   float height = fmaxf(maxy - grid->miny, 1e-6f);
+   grid->cell_size = sqrtf(width * height / cell_count);
+   grid->columns = (int)fminf(ceilf(width / grid->cell_size), 1 << 16);
+   grid->rows = (int)fminf(ceilf(height / grid->cell_size), 1 << 16);
+   grid->columns = grid->columns > 0 ? grid->columns : 1;
+   grid->rows = grid->rows > 0 ? grid->rows : 1;
+
+   Index cells = (Index)grid->columns * grid->rows;
+   grid->cells = malloc(cells * sizeof(Index));
+   assert(grid->cells != NULL && "Buy more RAM lol");
+   for (Index c = 0; c < cells; ++c)
+   {
+      grid->cells[c] = -1;
+   }
+
+   for (Index t = 0; t < delaunay->triangles.count; ++t)
+   {
+      track_triangle(delaunay, t);
+   }
+}
+
+void delaunay_interpolate(Delaunay* delaunay, Index t, Point p, float* out)
+{
+   Triangle* tr = &TRIA(delaunay, t);
+   Point* a = &POINT(delaunay, tr->ix1);
+   Point* b = &POINT(delaunay, tr->ix2);
+   Point* c = &POINT(delaunay, tr->ix3);
+
+   // barycentric weights, from twice the signed areas
+   double area = ((double)b->x - a->x) * ((double)c->y - a->y) - ((double)c->x - a->x) * ((double)b->y - a->y);
+   double wa = ((double)b->x - p.x) * ((double)c->y - p.y) - ((double)c->x - p.x) * ((double)b->y - p.y);
+   double wb = ((double)c->x - p.x) * ((double)a->y - p.y) - ((double)a->x - p.x) * ((double)c->y - p.y);
+   double w[3] = { wa, wb, area - wa - wb };
+   if (area == 0)
+   {
+      w[0] = w[1] = w[2] = 1;
+   }
+
+   // the super points carry no values, leave them out
+   Index ix[3] = { tr->ix1, tr->ix2, tr->ix3 };
+   double total = 0;
+   int real = 0;
+   for (int v = 0; v < 3; ++v)
+   {
+      w[v] = IS_SUPER_POINT(delaunay, ix[v]) ? 0 : w[v];
+      total += w[v];
+      real += !IS_SUPER_POINT(delaunay, ix[v]);
+   }
+
+   if (total <= 0)
+   {
+      // beyond the real points: their plain average
+      for (int v = 0; v < 3; ++v)
+      {
+         w[v] = IS_SUPER_POINT(delaunay, ix[v]) ? 0 : 1;
+      }
+      total = real;
+   }
+
+   int channels = delaunay->channels;
+   for (int k = 0; k < channels; ++k)
+   {
+      double value = 0;
+      for (int v = 0; v < 3; ++v)
+      {
+         value += w[v] * delaunay->attributes.items[ix[v] * channels + k];
+      }
+      out[k] = total > 0 ? (float)(value / total) : 0;
+   }
+}
+
+Index locate_by_scan(Delaunay* delaunay, Point* p)
+{
+   for (Index t = 0; t < delaunay->triangles.count; ++t)
+   {
+      Triangle* tr = &TRIA(delaunay, t);
+      if (point_in_triangle(p, &POINT(delaunay, tr->ix1), &POINT(delaunay, tr->ix2), &POINT(delaunay, tr->ix3)))
+      {
+         return t;
+      }
+   }
+
+   return -1;
+}
+
+// Visibility walk: step across any edge that has p on the other side than
+// the opposite corner, until no such edge is left. It always ends in a
+// Delaunay triangulation. The first edge tried rotates with every step so
+// degenerate input can't keep it circling. If the walk leaves the mesh or
+// runs too long, fall back to checking every triangle.
+Index locate_triangle(Delaunay* delaunay, Point* p)
+{
+   return locate_triangle_from(delaunay, p, -1);
+}
+
+Index locate_triangle_from(Delaunay* delaunay, Point* p, Index t)
+{
+   if (t == -1)
+   {
+      t = delaunay->locate_hint;
+      if (delaunay->grid.cells != NULL)
+      {
+         Index hint = grid_hint(&delaunay->grid, p->x, p->y);
+         t = hint != -1 ? hint : t;
+      }
+   }
+
+   if (t < 0 || t >= delaunay->triangles.count)
+   {
+      return locate_by_scan(delaunay, p);
+   }
+
+   for (Index step = 0; step < delaunay->triangles.count; ++step)
    {
       Triangle* tr = &TRIA(delaunay, t);
-      Point* p = &POINT(delaunay, delaunay->currentpoint);
-
-      Point a = POINT(delaunay, tr->ix1);
-      Point b = POINT(delaunay, tr->ix2);
-      Point c = POINT(delaunay, tr->ix3);
-      if (point_in_triangle(p, &a, &b, &c))
-      {
-         printf("Point %d is in triangle %d\n", delaunay->currentpoint, t);
-         found = true;
-
-         //printf("Point %.2f,%.2f is in triangle %d\n", p->x, p->y, t);
-         Triangle n1 = {
-            .ix1 = tr->ix1,
-            .ix2 = tr->ix2,
-            .ix3 = delaunay->currentpoint,
-            .circle = circle_from_triangle(&a, &b, p),
-            .neighbours = { -1, -1, -1 }
-         };
-         Triangle n2 = {
-            .ix1 = tr->ix2,
-            .ix2 = tr->ix3,
-            .ix3 = delaunay->currentpoint,
-            .circle = circle_from_triangle(&b, &c, p),
-            .neighbours = { -1, -1, -1 }
-         };
-         tr->ix2 = delaunay->currentpoint;
-         tr->circle = circle_from_triangle(&a, p, &c);
-
-         printf("A\n");
-         da_append(&delaunay->triangles, n1);
-         da_append(&delaunay->triangles, n2);
-
-         stack_push(t);
-         stack_push(delaunay->triangles.count - 1);
-         stack_push(delaunay->triangles.count - 2);
-         stack_push(tr->neighbours[0]);
-         stack_push(tr->neighbours[1]);
-         stack_push(tr->neighbours[2]);
-
-         printf("B\n");
-
-         for (int s = 0; s < stack_pointer; ++s)
+      Index ix[3] = { tr->ix1, tr->ix2, tr->ix3 };
+      Index next = -1;
+      for (int k = 0; k < 3 && next == -1; ++k)
+      {
+         int e = (int)((step + k) % 3);
+         Point* u = &POINT(delaunay, ix[e]);
+         Point* v = &POINT(delaunay, ix[(e + 1) % 3]);
+         Point* w = &POINT(delaunay, ix[(e + 2) % 3]);
+         if (orient2d(u, v, p) * orient2d(u, v, w) < 0)
+         {
+            int slot;
+            next = neighbour_across(delaunay, tr, ix[e], ix[(e + 1) % 3], &slot);
+            if (next == -1)
+            {
+               return locate_by_scan(delaunay, p);
+            }
+         }
+      }
+
+      if (next == -1)
+      {
+         return t;
+      }
+
+      t = next;
+   }
+
+   return locate_by_scan(delaunay, p);
+}
+
+void flip_insert(Delaunay* delaunay, Index t)
+{
+   Triangle* tr = &TRIA(delaunay, t);
+   Point* p = &POINT(delaunay, delaunay->currentpoint);
+
+   Point a = POINT(delaunay, tr->ix1);
+   Point b = POINT(delaunay, tr->ix2);
+   Point c = POINT(delaunay, tr->ix3);
+
+   //printf("Point %.2f,%.2f is in triangle %d\n", p->x, p->y, t);
+   Triangle n1 = {
+      .ix1 = tr->ix1,
+      .ix2 = tr->ix2,
+      .ix3 = delaunay->currentpoint,
+      .circle = circle_from_triangle(&a, &b, p),
+      .neighbours = { -1, -1, -1 }
+   };
+   Triangle n2 = {
+      .ix1 = tr->ix2,
+      .ix2 = tr->ix3,
+      .ix3 = delaunay->currentpoint,
+      .circle = circle_from_triangle(&b, &c, p),
+      .neighbours = { -1, -1, -1 }
+   };
+   tr->ix2 = delaunay->currentpoint;
+   tr->circle = circle_from_triangle(&a, p, &c);
+
+   da_append(&delaunay->triangles, n1);
+   da_append(&delaunay->triangles, n2);
+
+   // da_append may have moved the triangles
+   tr = &TRIA(delaunay, t);
+
+   track_triangle(delaunay, t);
+   track_triangle(delaunay, delaunay->triangles.count - 1);
+   track_triangle(delaunay, delaunay->triangles.count - 2);
+
+   stack_push(delaunay, t);
+   stack_push(delaunay, delaunay->triangles.count - 1);
+   stack_push(delaunay, delaunay->triangles.count - 2);
+   stack_push(delaunay, tr->neighbours[0]);
+   stack_push(delaunay, tr->neighbours[1]);
+   stack_push(delaunay, tr->neighbours[2]);
+
+   PROFILE_BEGIN("circles");
+   for (Index s = 0; s < delaunay->stack.count; ++s)
+   {
+      calculate_neighbours(delaunay, delaunay->stack.items[s]);
+      calculate_circle(delaunay, delaunay->stack.items[s]);
+   }
+   PROFILE_END();
+
+   PROFILE_BEGIN("flips");
+   while (process_stack(delaunay));
+   PROFILE_END();
+}
+
+bool has_point(Triangle* tr, Index ix)
+{
+   return tr->ix1 == ix || tr->ix2 == ix || tr->ix3 == ix;
+}
+
+// Neighbour of tr across edge u-v, or -1. Its position in tr->neighbours goes in *slot.
+Index neighbour_across(Delaunay* delaunay, Triangle* tr, Index u, Index v, int* slot)
+{
+   for (int n = 0; n < 3; ++n)
+   {
+      Index nix = tr->neighbours[n];
+      if (nix != -1 && has_point(&TRIA(delaunay, nix), u) && has_point(&TRIA(delaunay, nix), v))
+      {
+         *slot = n;
+         return nix;
+      }
+   }
+
+   *slot = -1;
+   return -1;
+}
+
+bool in_cavity(Indices* cavity, Index begin, Index t)
+{
+   for (Index i = begin; i < cavity->count; ++i)
+   {
+      if (cavity->items[i] == t)
+      {
+         return true;
+      }
+   }
+
+   return false;
+}
+
+void collect_cavity(Delaunay* delaunay, Index pix, Index t, Indices* cavity, Indices* boundary)
+{
+   Index begin = cavity->count;
+   da_append(cavity, t);
+
+   for (Index i = begin; i < cavity->count; ++i)
+   {
+      Index bix = cavity->items[i];
+      Triangle* tr = &TRIA(delaunay, bix);
+      Index edges[3][2] = {
+         { tr->ix1, tr->ix2 },
+         { tr->ix2, tr->ix3 },
+         { tr->ix3, tr->ix1 }
+      };
+
+      for (int e = 0; e < 3; ++e)
+      {
+         Index u = edges[e][0];
+         Index v = edges[e][1];
+         int slot = -1;
+         Index nix = neighbour_across(delaunay, tr, u, v, &slot);
+         if (nix != -1 && in_cavity(cavity, begin, nix))
          {
-            calculate_neighbours(delaunay, stack[s]);
-            calculate_circle(delaunay, stack[s]);
+            continue;
          }
-         printf("C\n");
 
-         while (process_stack(delaunay));
-         break;
+         if (nix != -1 && point_in_triangle_circle(delaunay, &TRIA(delaunay, nix), pix))
+         {
+            da_append(cavity, nix);
+            continue;
+         }
+
+         // remember where the outside triangle points back to us
+         int back = -1;
+         if (nix != -1)
+         {
+            neighbour_across(delaunay, &TRIA(delaunay, nix), u, v, &back);
+         }
+
+         da_append(boundary, u);
+         da_append(boundary, v);
+         da_append(boundary, nix);
+         da_append(boundary, back);
+      }
+   }
+}
+
+void fan_cavity(Delaunay* delaunay, Index pix, const Index* cavity, Index cavity_count, Index* boundary, Index edge_count, Index first_new)
+{
+   for (Index e = 0; e < edge_count; ++e)
+   {
+      Index* edge = &boundary[e * 4];
+      Index tix = e < cavity_count ? cavity[e] : first_new + e - cavity_count;
+
+      Triangle* tr = &TRIA(delaunay, tix);
+      tr->ix1 = edge[0];
+      tr->ix2 = edge[1];
+      tr->ix3 = pix;
+      tr->neighbours[0] = edge[2];
+      tr->neighbours[1] = -1;
+      tr->neighbours[2] = -1;
+      calculate_circle(delaunay, tix);
+
+      if (edge[2] != -1)
+      {
+         TRIA(delaunay, edge[2]).neighbours[edge[3]] = tix;
+      }
+
+      // the edge is reused as the triangle index from here on
+      edge[3] = tix;
+   }
+
+   // fan triangles sharing a boundary vertex are neighbours
+   for (Index e = 0; e < edge_count; ++e)
+   {
+      Index* edge = &boundary[e * 4];
+      for (Index f = e + 1; f < edge_count; ++f)
+      {
+         Index* other = &boundary[f * 4];
+         if (edge[0] == other[1] || edge[1] == other[0] || edge[0] == other[0] || edge[1] == other[1])
+         {
+            add_neightbour(&TRIA(delaunay, edge[3]), other[3]);
+            add_neightbour(&TRIA(delaunay, other[3]), edge[3]);
+         }
+      }
+   }
+}
+
+void cavity_insert(Delaunay* delaunay, Index pix, Index t)
+{
+   PROFILE_BEGIN("grow");
+   delaunay->cavity.count = 0;
+   delaunay->boundary.count = 0;
+   collect_cavity(delaunay, pix, t, &delaunay->cavity, &delaunay->boundary);
+   PROFILE_END();
+
+   PROFILE_SCOPE("refan");
+
+   // every boundary edge becomes a triangle with the new point,
+   // reusing the slots of the removed triangles first
+   Index edge_count = delaunay->boundary.count / 4;
+   Index first_new = delaunay->triangles.count;
+   for (Index e = delaunay->cavity.count; e < edge_count; ++e)
+   {
+      Triangle empty = { 0 };
+      da_append(&delaunay->triangles, empty);
+   }
+
+   fan_cavity(delaunay, pix, delaunay->cavity.items, delaunay->cavity.count, delaunay->boundary.items, edge_count, first_new);
+   for (Index e = 0; e < edge_count; ++e)
+   {
+      track_triangle(delaunay, delaunay->boundary.items[e * 4 + 3]);
+   }
+}
+
+// The vertex of tr at the position of point_ix, or -1.
+Index has_duplicate(Delaunay* delaunay, Triangle* tr, Index point_ix)
+{
+   Point* p = &POINT(delaunay, point_ix);
+   Index ix[3] = { tr->ix1, tr->ix2, tr->ix3 };
+   for (int k = 0; k < 3; ++k)
+   {
+      if (POINT(delaunay, ix[k]).x == p->x && POINT(delaunay, ix[k]).y == p->y)
+      {
+         return ix[k];
       }
    }
 
-   if (!found)
+   return -1;
+}
+
+// Removes the not yet inserted point ix by moving the last point into its
+// place. Input points that went to ix go to duplicate instead.
+void drop_point(Delaunay* delaunay, Index ix, Index duplicate)
+{
+   Index last = delaunay->points.count - 1;
+   POINT(delaunay, ix) = POINT(delaunay, last);
+   delaunay->points.count--;
+
+   if (ix - 3 < delaunay->source.count)
+   {
+      delaunay->source.items[ix - 3] = last - 3 < delaunay->source.count ? delaunay->source.items[last - 3] : -1;
+   }
+   if (delaunay->source.count > last - 3)
+   {
+      delaunay->source.count = last - 3;
+   }
+
+   int channels = delaunay->channels;
+   for (int c = 0; c < channels; ++c)
+   {
+      delaunay->attributes.items[ix * channels + c] = delaunay->attributes.items[last * channels + c];
+   }
+   delaunay->attributes.count = last * channels;
+
+   for (Index i = 0; i < delaunay->vertex.count; ++i)
+   {
+      Index v = delaunay->vertex.items[i];
+      delaunay->vertex.items[i] = v == ix ? duplicate : (v == last ? ix : v);
+   }
+}
+
+void delaunay_step(Delaunay* delaunay)
+{
+   if (delaunay->currentpoint >= delaunay->points.count)
+   {
+      // printf("No steps left\n");
+      return;
+   }
+
+   if (delaunay->finalized)
+   {
+      printf("ERROR: can't insert into a finalized mesh\n");
+      return;
+   }
+
+   PROFILE_SCOPE("step");
+
+   PROFILE_BEGIN("locate");
+   Index t = locate_triangle(delaunay, &POINT(delaunay, delaunay->currentpoint));
+   PROFILE_END();
+   Index duplicate = t != -1 ? has_duplicate(delaunay, &TRIA(delaunay, t), delaunay->currentpoint) : -1;
+   if (t == -1)
+   {
+      printf("ERROR: Point #%" PRIidx " not in any triangle\n", delaunay->currentpoint);
+   }
+   else if (duplicate != -1)
    {
-      printf("ERROR: Point #%d not in any triangle\n", delaunay->currentpoint);
+      // would make zero-area triangles, and never end flipping
+      delaunay->dropped++;
+      drop_point(delaunay, delaunay->currentpoint, duplicate);
+      return;
+   }
+   else if (delaunay->engine == ENGINE_CAVITY)
+   {
+      cavity_insert(delaunay, delaunay->currentpoint, t);
+   }
+   else
+   {
+      //printf("Point %d is in triangle %d\n", delaunay->currentpoint, t);
+      flip_insert(delaunay, t);
    }
    
    //printf("Triangle count: %d\n", delaunay->triangles.count);
-   //stack_print();
+   //stack_print(delaunay);
    delaunay->currentpoint++;
 }
 
+// Checks the mesh built so far in one pass over the triangles:
+// indices, non-degenerate triangles, symmetric adjacency over a shared
+// edge, neighbours on opposite sides of it, no missing neighbour inside
+// the super triangle, and the empty-circle property against each
+// neighbour's far vertex (up to rounding, see cocircular_within_rounding()).
+// Prints every problem found and returns how many there were.
+int delaunay_validate(Delaunay* delaunay)
+{
+   int errors = 0;
+   Index inserted = delaunay->currentpoint;
+
+   if (!delaunay->finalized && inserted >= 3 && delaunay->triangles.count != 2 * inserted - 5)
+   {
+      printf("ERROR: %" PRIidx " triangles for %" PRIidx " points, expected %" PRIidx "\n", delaunay->triangles.count, inserted, 2 * inserted - 5);
+      errors++;
+   }
+
+   for (Index t = 0; t < delaunay->triangles.count; ++t)
+   {
+      Triangle* tr = &TRIA(delaunay, t);
+      Index ix[3] = { tr->ix1, tr->ix2, tr->ix3 };
+
+      bool indices_ok = true;
+      for (int i = 0; i < 3; ++i)
+      {
+         if (ix[i] < 0 || ix[i] >= inserted)
+         {
+            printf("ERROR: T #%" PRIidx " uses point #%" PRIidx " which is not inserted\n", t, ix[i]);
+            indices_ok = false;
+         }
+      }
+
+      if (ix[0] == ix[1] || ix[1] == ix[2] || ix[0] == ix[2])
+      {
+         printf("ERROR: T #%" PRIidx " uses a point twice\n", t);
+         indices_ok = false;
+      }
+
+      if (!indices_ok)
+      {
+         errors++;
+         continue;
+      }
+
+      if (orient2d(&POINT(delaunay, ix[0]), &POINT(delaunay, ix[1]), &POINT(delaunay, ix[2])) == 0)
+      {
+         printf("ERROR: T #%" PRIidx " is degenerate\n", t);
+         errors++;
+      }
+
+      bool neighbours_ok = true;
+      for (int n = 0; n < 3; ++n)
+      {
+         Index nix = tr->neighbours[n];
+         if (nix == -1)
+         {
+            continue;
+         }
+
+         if (nix < 0 || nix >= delaunay->triangles.count || nix == t)
+         {
+            printf("ERROR: T #%" PRIidx " has invalid neighbour #%" PRIidx "\n", t, nix);
+            errors++;
+            neighbours_ok = false;
+            continue;
+         }
+
+         Triangle* ntr = &TRIA(delaunay, nix);
+         if (!has_2_points_in_common(tr, ntr))
+         {
+            printf("ERROR: T #%" PRIidx " and neighbour #%" PRIidx " don't share an edge\n", t, nix);
+            errors++;
+            continue;
+         }
 
+         if (ntr->neighbours[0] != t && ntr->neighbours[1] != t && ntr->neighbours[2] != t)
+         {
+            printf("ERROR: T #%" PRIidx " lists #%" PRIidx " as neighbour, but not the other way around\n", t, nix);
+            errors++;
+         }
 
+         if (tr->neighbours[(n + 1) % 3] == nix || tr->neighbours[(n + 2) % 3] == nix)
+         {
+            printf("ERROR: T #%" PRIidx " lists neighbour #%" PRIidx " twice\n", t, nix);
+            errors++;
+         }
 
+         Index far = not_common_point(tr, ntr);
+         if (point_in_triangle_circle(delaunay, tr, far) && !cocircular_within_rounding(delaunay, tr, far))
+         {
+            printf("ERROR: T #%" PRIidx " is not Delaunay against neighbour #%" PRIidx "\n", t, nix);
+            errors++;
+         }
+      }
+
+      if (!neighbours_ok)
+      {
+         continue;
+      }
 
+      // per edge: the neighbour lies on the other side, and only the super
+      // triangle's own edges (or the border, once finalized) have none
+      for (int e = 0; e < 3; ++e)
+      {
+         Index u = ix[e];
+         Index v = ix[(e + 1) % 3];
+         int slot;
+         Index nix = neighbour_across(delaunay, tr, u, v, &slot);
+         if (nix == -1)
+         {
+            if (!delaunay->finalized && !(IS_SUPER_POINT(delaunay, u) && IS_SUPER_POINT(delaunay, v)))
+            {
+               printf("ERROR: T #%" PRIidx " has no neighbour across %" PRIidx "-%" PRIidx "\n", t, u, v);
+               errors++;
+            }
+            continue;
+         }
 
+         Index far = not_common_point(tr, &TRIA(delaunay, nix));
+         int own_side = orient2d(&POINT(delaunay, u), &POINT(delaunay, v), &POINT(delaunay, ix[(e + 2) % 3]));
+         int far_side = orient2d(&POINT(delaunay, u), &POINT(delaunay, v), &POINT(delaunay, far));
+         if (own_side * far_side >= 0)
+         {
+            printf("ERROR: T #%" PRIidx " and neighbour #%" PRIidx " are on the same side of their edge\n", t, nix);
+            errors++;
+         }
+      }
+   }
 
+   return errors;
+}
 
+int sort_by_key(const void* aa, const void* bb)
+{
+   const SortKey* a = (const SortKey*)aa;
+   const SortKey* b = (const SortKey*)bb;
 
+   if (a->key != b->key)
+   {
+      return a->key < b->key ? -1 : 1;
+   }
 
+   return (a->index > b->index) - (a->index < b->index);
+}
 
+int sort_by_key_point(const void* aa, const void* bb)
+{
+   const PointKey* a = (const PointKey*)aa;
+   const PointKey* b = (const PointKey*)bb;
 
+   if (a->key != b->key)
+   {
+      return a->key < b->key ? -1 : 1;
+   }
 
+   if (a->p.x != b->p.x)
+   {
+      return a->p.x < b->p.x ? -1 : 1;
+   }
 
+   if (a->p.y != b->p.y)
+   {
+      return a->p.y < b->p.y ? -1 : 1;
+   }
 
+   return (a->index > b->index) - (a->index < b->index);
+}
 
-int block_index(const Point* p)
+// Drops the super triangle and everything attached to it, then renumbers
+// points and triangles along a Hilbert curve so that walking the finished
+// mesh touches memory in order. All indices and neighbours are rewritten.
+void delaunay_finalize(Delaunay* delaunay)
 {
-   #define REGION_SIZE 50
+   if (delaunay->finalized)
+   {
+      return;
+   }
+
+   if (delaunay->currentpoint < delaunay->points.count)
+   {
+      printf("ERROR: finalize with %" PRIidx " points not inserted\n", delaunay->points.count - delaunay->currentpoint);
+      return;
+   }
+
+   PROFILE_SCOPE("finalize");
+
+   Index point_count = delaunay->points.count - 3;
+   float minx = FLT_MAX;
+   float maxx = -FLT_MAX;
+   float miny = FLT_MAX;
+   float maxy = -FLT_MAX;
+   for (Index i = 3; i < delaunay->points.count; ++i)
+   {
+      minx = fminf(POINT(delaunay, i).x, minx);
+      maxx = fmaxf(POINT(delaunay, i).x, maxx);
+      miny = fminf(POINT(delaunay, i).y, miny);
+      maxy = fmaxf(POINT(delaunay, i).y, maxy);
+   }
+
+   CurveFrame frame = curve_frame(minx, miny, maxx, maxy);
+
+   // points
+   SortKey* keys = malloc((point_count > 0 ? point_count : 1) * sizeof(SortKey));
+   for (Index i = 0; i < point_count; ++i)
+   {
+      Point* p = &POINT(delaunay, i + 3);
+      keys[i] = (SortKey) { .key = curve_key(&frame, p->x, p->y), .index = i + 3 };
+   }
+   qsort(keys, point_count, sizeof(SortKey), sort_by_key);
+
+   Index* point_remap = malloc(delaunay->points.count * sizeof(Index));
+   Point* points = malloc((point_count > 0 ? point_count : 1) * sizeof(Point));
+   Index* source = malloc((point_count > 0 ? point_count : 1) * sizeof(Index));
+   int channels = delaunay->channels;
+   float* attributes = malloc((point_count * channels > 0 ? point_count * channels : 1) * sizeof(float));
+   point_remap[0] = point_remap[1] = point_remap[2] = -1;
+   for (Index i = 0; i < point_count; ++i)
+   {
+      Index old = keys[i].index - 3;
+      point_remap[keys[i].index] = i;
+      points[i] = POINT(delaunay, keys[i].index);
+      source[i] = old < delaunay->source.count ? delaunay->source.items[old] : -1;
+      for (int c = 0; c < channels; ++c)
+      {
+         attributes[i * channels + c] = delaunay->attributes.items[keys[i].index * channels + c];
+      }
+   }
+   free(keys);
+
+   // triangles, by centroid
+   keys = malloc((delaunay->triangles.count > 0 ? delaunay->triangles.count : 1) * sizeof(SortKey));
+   Index kept = 0;
+   for (Index t = 0; t < delaunay->triangles.count; ++t)
+   {
+      Triangle* tr = &TRIA(delaunay, t);
+      if (tr->ix1 < 3 || tr->ix2 < 3 || tr->ix3 < 3)
+      {
+         continue;
+      }
+
+      float cx = ((float)POINT(delaunay, tr->ix1).x + POINT(delaunay, tr->ix2).x + POINT(delaunay, tr->ix3).x) / 3;
+      float cy = ((float)POINT(delaunay, tr->ix1).y + POINT(delaunay, tr->ix2).y + POINT(delaunay, tr->ix3).y) / 3;
+      keys[kept++] = (SortKey) { .key = curve_key(&frame, cx, cy), .index = t };
+   }
+   qsort(keys, kept, sizeof(SortKey), sort_by_key);
+
+   Index* triangle_remap = malloc((delaunay->triangles.count > 0 ? delaunay->triangles.count : 1) * sizeof(Index));
+   for (Index t = 0; t < delaunay->triangles.count; ++t)
+   {
+      triangle_remap[t] = -1;
+   }
+
+   for (Index i = 0; i < kept; ++i)
+   {
+      triangle_remap[keys[i].index] = i;
+   }
 
-   int x = p->x / REGION_SIZE;
-   int y = p->y / REGION_SIZE;
-   if (y % 2 == 1)
+   Triangle* triangles = malloc((kept > 0 ? kept : 1) * sizeof(Triangle));
+   for (Index i = 0; i < kept; ++i)
+   {
+      Triangle tr = TRIA(delaunay, keys[i].index);
+      tr.ix1 = point_remap[tr.ix1];
+      tr.ix2 = point_remap[tr.ix2];
+      tr.ix3 = point_remap[tr.ix3];
+      for (int n = 0; n < 3; ++n)
+      {
+         if (tr.neighbours[n] != -1)
+         {
+            tr.neighbours[n] = triangle_remap[tr.neighbours[n]];
+         }
+      }
+
+      triangles[i] = tr;
+   }
+
+   for (Index i = 0; i < delaunay->vertex.count; ++i)
+   {
+      delaunay->vertex.items[i] = point_remap[delaunay->vertex.items[i]];
+   }
+
+   free(keys);
+   free(point_remap);
+   free(triangle_remap);
+
+   da_free(delaunay->points);
+   da_free(delaunay->triangles);
+   da_free(delaunay->source);
+   da_free(delaunay->attributes);
+   delaunay->points = (Points) { .items = points, .count = point_count, .capacity = point_count > 0 ? point_count : 1 };
+   delaunay->source = (Indices) { .items = source, .count = point_count, .capacity = point_count > 0 ? point_count : 1 };
+   delaunay->attributes = (Floats) { .items = attributes, .count = point_count * channels, .capacity = point_count * channels > 0 ? point_count * channels : 1 };
+   delaunay->triangles = (Triangles) { .items = triangles, .count = kept, .capacity = kept > 0 ? kept : 1 };
+   delaunay->currentpoint = point_count;
+   delaunay->stack.count = 0;
+   delaunay->finalized = true;
+   delaunay->locate_hint = kept > 0 ? 0 : -1;
+   free(delaunay->grid.cells);
+   delaunay->grid = (LocateGrid) { 0 };
+
+   delaunay->hull_hint = -1;
+   for (Index t = 0; t < kept && delaunay->hull_hint == -1; ++t)
    {
-      x = (2000 / REGION_SIZE) - x;
+      if (TRIA(delaunay, t).neighbours[0] == -1 || TRIA(delaunay, t).neighbours[1] == -1 || TRIA(delaunay, t).neighbours[2] == -1)
+      {
+         delaunay->hull_hint = t;
+      }
    }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+CurveFrame curve_frame(float minx, float miny, float maxx, float maxy)
+{
+   return (CurveFrame) {
+      .minx = minx,
+      .miny = miny,
+      .scalex = maxx > minx ? 65535.0f / (maxx - minx) : 0,
+      .scaley = maxy > miny ? 65535.0f / (maxy - miny) : 0
+   };
+}
+
+// Snapped points can end up just outside the bounds, they are clamped.
+int64_t curve_key(const CurveFrame* frame, float x, float y)
+{
+   float u = (x - frame->minx) * frame->scalex;
+   float v = (y - frame->miny) * frame->scaley;
+   u = u < 0 ? 0 : (u > 65535 ? 65535 : u);
+   v = v < 0 ? 0 : (v > 65535 ? 65535 : v);
+   return hilbert_index((uint32_t)u, (uint32_t)v);
+}
 
-   return x + y * (2000 / REGION_SIZE);
+// Exact when built with DELAUNAY_INT_COORDS: differences fit in 32 bits,
+// 2x2 determinants in 64 bits and the in-circle determinant in 128 bits.
+#ifdef DELAUNAY_INT_COORDS
+typedef int64_t Det;
+typedef __int128 BigDet;
+#else
+typedef double Det;
+typedef double BigDet;
+#endif
+
+int orient2d(const Point* a, const Point* b, const Point* c)
+{
+   Det abx = (Det)b->x - a->x;
+   Det aby = (Det)b->y - a->y;
+   Det acx = (Det)c->x - a->x;
+   Det acy = (Det)c->y - a->y;
+   Det det = abx * acy - aby * acx;
+
+   return (det > 0) - (det < 0);
 }
 
-int sort_by_region(const void* aa, const void* bb)
+// Sign of the lifted 4x4 determinant of a, b, c, d: > 0 when d is inside the
+// circle through a, b and c taken counter-clockwise
+int in_circle_det(const Point* a, const Point* b, const Point* c, const Point* d)
 {
-   Point* a = (Point*)aa;
-   Point* b = (Point*)bb;
+   Det adx = (Det)a->x - d->x;
+   Det ady = (Det)a->y - d->y;
+   Det bdx = (Det)b->x - d->x;
+   Det bdy = (Det)b->y - d->y;
+   Det cdx = (Det)c->x - d->x;
+   Det cdy = (Det)c->y - d->y;
+
+   BigDet alift = (BigDet)(adx * adx + ady * ady);
+   BigDet blift = (BigDet)(bdx * bdx + bdy * bdy);
+   BigDet clift = (BigDet)(cdx * cdx + cdy * cdy);
+
+   BigDet det = alift * (BigDet)(bdx * cdy - cdx * bdy)
+              + blift * (BigDet)(cdx * ady - adx * cdy)
+              + clift * (BigDet)(adx * bdy - bdx * ady);
+
+   return (det > 0) - (det < 0);
+}
+
+// > 0 when d lies strictly inside the circle through a, b and c,
+// whatever the winding of a, b, c
+int in_circle(const Point* a, const Point* b, const Point* c, const Point* d)
+{
+   return in_circle_det(a, b, c, d) * orient2d(a, b, c);
+}
+
+bool point_in_triangle_circle(Delaunay* delaunay, Triangle* tr, Index point_ix)
+{
+   // With floats the determinant is rounded. Evaluating it with the four points
+   // in index order gives the same answer for both sides of an edge, so the
+   // flip engine can't keep flipping a near co-circular edge back and forth.
+   Index ix[4] = { tr->ix1, tr->ix2, tr->ix3, point_ix };
+   int parity = 1;
+   for (int i = 0; i < 4; ++i)
+   {
+      for (int j = 0; j < 3 - i; ++j)
+      {
+         if (ix[j] > ix[j + 1])
+         {
+            Index temp = ix[j];
+            ix[j] = ix[j + 1];
+            ix[j + 1] = temp;
+            parity = -parity;
+         }
+      }
+   }
+
+   int det = in_circle_det(&POINT(delaunay, ix[0]), &POINT(delaunay, ix[1]),
+                           &POINT(delaunay, ix[2]), &POINT(delaunay, ix[3]));
 
-   return block_index(a) - block_index(b);
+   return parity * det * orient2d(&POINT(delaunay, tr->ix1),
+                                  &POINT(delaunay, tr->ix2),
+                                  &POINT(delaunay, tr->ix3)) > 0;
 }
 
-bool point_in_circle(Point p, Circle c)
+// With float coordinates the in-circle determinant is rounded, so points that
+// are co-circular up to rounding (the rings generator) may test either way
+// depending on how they are numbered, which delaunay_finalize() changes.
+// True when point_ix is that close to the circle of tr.
+bool cocircular_within_rounding(Delaunay* delaunay, Triangle* tr, Index point_ix)
 {
-   return distance(p, c.center) <= c.radius;
+#ifdef DELAUNAY_INT_COORDS
+   (void)delaunay;
+   (void)tr;
+   (void)point_ix;
+   return false;
+#else
+   Point* a = &POINT(delaunay, tr->ix1);
+   Point* b = &POINT(delaunay, tr->ix2);
+   Point* c = &POINT(delaunay, tr->ix3);
+   Point* p = &POINT(delaunay, point_ix);
+
+   double adx = (double)a->x - p->x, ady = (double)a->y - p->y;
+   double bdx = (double)b->x - p->x, bdy = (double)b->y - p->y;
+   double cdx = (double)c->x - p->x, cdy = (double)c->y - p->y;
+
+   double alift = adx * adx + ady * ady;
+   double blift = bdx * bdx + bdy * bdy;
+   double clift = cdx * cdx + cdy * cdy;
+
+   double det = alift * (bdx * cdy - cdx * bdy)
+              + blift * (cdx * ady - adx * cdy)
+              + clift * (adx * bdy - bdx * ady);
+   double permanent = alift * (fabs(bdx * cdy) + fabs(cdx * bdy))
+                    + blift * (fabs(cdx * ady) + fabs(adx * cdy))
+                    + clift * (fabs(adx * bdy) + fabs(bdx * ady));
+
+   return fabs(det) <= 1e-14 * permanent;
+#endif
 }
 
 bool point_in_triangle(Point* p, Point* a, Point* b, Point* c)
 {
-   // P = A + w1 * (B - A) + w2 * (C - A);
-   float cyay = c->y - a->y;
-   float cxax = c->x - a->x;
-   float bxax = b->x - a->x;
-   float byay = b->y - a->y;
-   float pyay = p->y - a->y;
-   // float pxax = p->x - a->x;
+   // inside or on the border when p is on the same side of all three edges
+   int o1 = orient2d(a, b, p);
+   int o2 = orient2d(b, c, p);
+   int o3 = orient2d(c, a, p);
 
-   float w1 = (a->x * cyay + pyay * cxax - p->x * cyay) / (byay * cxax - bxax * cyay);
-   float w2 = (p->y - a->y - w1 * byay) / cyay;
+   bool has_neg = o1 < 0 || o2 < 0 || o3 < 0;
+   bool has_pos = o1 > 0 || o2 > 0 || o3 > 0;
 
-   return w1 >= 0.0f && w2 >= 0.0f && (w1 + w2) <= 1.0f;
+   return !(has_neg && has_pos);
 }
 
 Line linear_eq(Point* p1, Point* p2)
@@ -563,24 +1582,22 @@ Point points_lerp(float value, Point a, Point b)
 
 Circle circle_from_triangle(Point* a, Point* b, Point* c)
 {
-   // https://www.youtube.com/watch?v=uIBGSztyB04
-   Line ab = linear_eq(a, b);
-   Line bc = linear_eq(b, c);
-
-   // printf("Line ab: %.2f %.2f %.2f\n", ab.a, ab.b, ab.c);
-   // printf("Line bc: %.2f %.2f %.2f\n", bc.a, bc.b, bc.c);
+   // https://en.wikipedia.org/wiki/Circumcircle#Cartesian_coordinates_2
+   // Relative to a, so that integer coordinates don't lose precision.
+   double bx = (double)b->x - a->x;
+   double by = (double)b->y - a->y;
+   double cx = (double)c->x - a->x;
+   double cy = (double)c->y - a->y;
+
+   double d = 2 * (bx * cy - by * cx);
+   double b2 = bx * bx + by * by;
+   double c2 = cx * cx + cy * cy;
+   double ux = (cy * b2 - by * c2) / d;
+   double uy = (bx * c2 - cx * b2) / d;
 
-   Point mid_ab = points_lerp(0.5f, *a, *b);
-   Point mid_bc = points_lerp(0.5f, *b, *c);
-
-   Line perp_ab = perp_line(&mid_ab, &ab);
-   Line perp_bc = perp_line(&mid_bc, &bc);
-
-   Point crossing = crossing_point(&perp_ab, &perp_bc);
-   
    Circle ci = {
-      .center = crossing,
-      .radius = distance(*a, crossing)
+      .center = { .x = a->x + ux, .y = a->y + uy },
+      .radius = sqrt(ux * ux + uy * uy)
    };
    
    return ci;
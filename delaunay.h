@@ -1,10 +1,23 @@
 #ifndef _DELAUNAY_H_
 #define _DELAUNAY_H_
 
+#include <inttypes.h>
+#include <stdbool.h>
 #include "vector2.h"
 
 #define Point Vec2
 
+// Index type of points and triangles, also used for their counts.
+// Build with -DDELAUNAY_INDEX64 for meshes beyond 2^31 triangles, which
+// makes a triangle 64 bytes instead of 36. Print with "%" PRIidx.
+#ifdef DELAUNAY_INDEX64
+typedef int64_t Index;
+#define PRIidx PRId64
+#else
+typedef int32_t Index;
+#define PRIidx PRId32
+#endif
+
 typedef struct {
    float a;
    float b;
@@ -12,34 +25,77 @@ typedef struct {
 } Line;
 
 typedef struct {
-   Point center;
+   Vec2f center;
    float radius;
 } Circle;
 
 typedef struct {
-   int ix1;
-   int ix2;
-   int ix3;
+   Index ix1;
+   Index ix2;
+   Index ix3;
    Circle circle;
-   int neighbours[3];
+   Index neighbours[3];
 } Triangle;
 
 typedef struct {
    Triangle* items;
-   int count;
-   int capacity;
+   Index count;
+   Index capacity;
 } Triangles;
 
 typedef struct {
    Point* items;
-   int count;
-   int capacity;
+   Index count;
+   Index capacity;
 } Points;
 
+typedef struct {
+   Index* items;
+   Index count;
+   Index capacity;
+} Indices;
+
+typedef struct {
+   float* items;
+   Index count;
+   Index capacity;
+} Floats;
+
+typedef enum {
+   ENGINE_FLIP,         // split the containing triangle in 3, then flip edges
+   ENGINE_CAVITY,       // Bowyer-Watson: remove the conflict cavity and re-fan it
+} Engine;
+
+// Optional point location accelerator: a uniform grid over the bounds of
+// the points, every cell holding a triangle that was written near it
+// lately. Walks start from the cell of the point instead of from wherever
+// the last insertion happened.
+typedef struct {
+   Index* cells;        // -1 until a triangle lands in the cell
+   int columns;
+   int rows;
+   float minx;
+   float miny;
+   float cell_size;
+} LocateGrid;
+
 typedef struct {
    Points points;
    Triangles triangles;
-   int currentpoint;
+   Index currentpoint;
+   Engine engine;
+   bool finalized;      // super triangle removed by delaunay_finalize()
+   Index hull_hint;     // a triangle on the hull: touching the super triangle, or on the border once finalized
+   Index locate_hint;   // last triangle written, where locate_triangle() walks from without a grid
+   LocateGrid grid;     // see delaunay_use_grid()
+   Indices source;      // caller's index of point i + 3 (i once finalized), -1 or missing for points added later
+   Indices vertex;      // mesh point of the caller's point i, duplicates share one; empty unless deduplicated
+   Index dropped;       // points delaunay_step() left out for landing on an inserted one
+   int channels;        // attribute values per point, 0 without attributes
+   Floats attributes;   // channels values per point, point i at i * channels, 0 for the super points
+   Indices stack;       // triangles still to be checked by process_stack()
+   Indices cavity;      // scratch for ENGINE_CAVITY: conflicting triangles
+   Indices boundary;    // scratch for ENGINE_CAVITY: u, v, outside, slot per edge
 } Delaunay;
 
 
@@ -49,12 +105,62 @@ typedef struct {
 #define POINTV(d, ix)  (d.points.items[ix])
 #define TRIAV(d, ix)  (d.triangles.items[ix])
 
+// points 0..2 are the super triangle until delaunay_finalize() drops them
+#define IS_SUPER_POINT(d, ix)  (!(d)->finalized && (ix) < 3)
+
 // public
-Delaunay delaunay_init(Point* points, int point_count);
+// The points are copied, in insertion order, the caller keeps its array.
+Delaunay delaunay_init(const Point* points, Index point_count);
+Delaunay delaunay_init_engine(const Point* points, Index point_count, Engine engine);
+// Same, every point carrying channels floats (elevation, ...) from
+// attributes[i * channels], which follow it through sorting and finalize.
+Delaunay delaunay_init_attributes(const Point* points, const float* attributes, int channels, Index point_count, Engine engine);
+// Same, merging duplicates before anything is inserted: points are snapped
+// to multiples of tolerance (0: left as they are), those that then coincide
+// become one mesh point with the position and attributes of the first.
+// delaunay->vertex tells which mesh point each input point went to.
+Delaunay delaunay_init_dedupe(const Point* points, const float* attributes, int channels, Index point_count, Engine engine, float tolerance);
 void delaunay_free(Delaunay* delaunay);
+// Inserts the next point. One that lands on an inserted point is dropped
+// and counted in delaunay->dropped, the last point takes its place.
 void delaunay_step(Delaunay* delaunay);
+int delaunay_validate(Delaunay* delaunay);
+void delaunay_finalize(Delaunay* delaunay);
+
+// Builds a LocateGrid of about cell_count cells (0: one per point) over the
+// bounds of all points, inserted or not. Worth it when points are located
+// in no particular order, as with refinement. Dropped by delaunay_finalize().
+void delaunay_use_grid(Delaunay* delaunay, Index cell_count);
+
+// Linear interpolation of the attributes of triangle t at p, into
+// out[0 .. channels - 1], leaving out super points. Points added after init
+// (refinement, batch insertion) take these.
+void delaunay_interpolate(Delaunay* delaunay, Index t, Point p, float* out);
+
+// predicates
+int orient2d(const Point* a, const Point* b, const Point* c);
+int in_circle(const Point* a, const Point* b, const Point* c, const Point* d);
+bool point_in_triangle_circle(Delaunay* delaunay, Triangle* tr, Index point_ix);
+bool cocircular_within_rounding(Delaunay* delaunay, Triangle* tr, Index point_ix);
 
 // private
+Index locate_triangle(Delaunay* delaunay, Point* p);
+// Same, walking from triangle t, or from the grid or locate_hint when -1.
+Index locate_triangle_from(Delaunay* delaunay, Point* p, Index t);
+bool has_point(Triangle* tr, Index ix);
+Index neighbour_across(Delaunay* delaunay, Triangle* tr, Index u, Index v, int* slot);
+
+// Bowyer-Watson in two halves. collect_cavity() appends the triangles whose
+// circumcircle holds point pix, grown from t which contains it, to cavity
+// and the edges around them to boundary (u, v, outside, slot), only
+// reading the mesh. fan_cavity() replaces them with one triangle per edge,
+// in the cavity slots and then from first_new on, writing nothing but those
+// and the outside triangles' back links. Edge slot 3 becomes its triangle.
+void collect_cavity(Delaunay* delaunay, Index pix, Index t, Indices* cavity, Indices* boundary);
+void fan_cavity(Delaunay* delaunay, Index pix, const Index* cavity, Index cavity_count, Index* boundary, Index edge_count, Index first_new);
+// Both halves for point pix in triangle t, appending triangles as needed.
+void cavity_insert(Delaunay* delaunay, Index pix, Index t);
+void track_triangle(Delaunay* delaunay, Index t);
 bool point_in_triangle(Point* p, Point* a, Point* b, Point* c);
 Point points_lerp(float value, Point a, Point b);
 Circle circle_from_triangle(Point* a, Point* b, Point* c);
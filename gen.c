@@ -0,0 +1,149 @@
+#include <math.h>
+#include <stdint.h>
+#include "delaunay.h"
+#include "gen.h"
+
+#define GEN_CLUSTER_COUNT 8
+#define GEN_WIDE_EXTENT 1e7f
+
+const char* gen_names[GEN_COUNT] = {
+   "uniform", "clusters", "grid", "rings", "collinear", "duplicates", "wide"
+};
+
+const char* gen_name(GenKind kind)
+{
+   return kind >= 0 && kind < GEN_COUNT ? gen_names[kind] : "?";
+}
+
+// https://prng.di.unimi.it/splitmix64.c
+uint64_t splitmix64(uint64_t x)
+{
+   x += 0x9E3779B97F4A7C15ull;
+   x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+   x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+   return x ^ (x >> 31);
+}
+
+// uniform in [0, 1), stream picks one of several numbers for the same point
+float gen_random(Generator* gen, Index i, int stream)
+{
+   uint64_t h = splitmix64(gen->seed ^ splitmix64((uint64_t)i * 8 + stream));
+   return (h >> 40) / (float)(1 << 24);
+}
+
+Point gen_uniform(Generator* gen, Index i)
+{
+   return (Point) {
+      .x = gen->x + gen_random(gen, i, 0) * gen->width,
+      .y = gen->y + gen_random(gen, i, 1) * gen->height
+   };
+}
+
+Point gen_point(Generator* gen, Index i)
+{
+   float cx = gen->x + gen->width / 2;
+   float cy = gen->y + gen->height / 2;
+   float size = fminf(gen->width, gen->height);
+
+   switch (gen->kind)
+   {
+      case GEN_CLUSTERS:
+      {
+         int cluster = (int)(gen_random(gen, i, 2) * GEN_CLUSTER_COUNT);
+         Point center = gen_uniform(gen, -1 - cluster);
+
+         // Box-Muller
+         float r = sqrtf(-2 * logf(1 - gen_random(gen, i, 0))) * size / 40;
+         float a = 2 * M_PI * gen_random(gen, i, 1);
+         return (Point) {
+            .x = fminf(fmaxf(center.x + r * cosf(a), gen->x), gen->x + gen->width),
+            .y = fminf(fmaxf(center.y + r * sinf(a), gen->y), gen->y + gen->height)
+         };
+      }
+
+      case GEN_GRID:
+      {
+         Index side = (Index)ceil(sqrt(gen->count));
+         float step = fmaxf(1, floorf(size / side));
+         return (Point) {
+            .x = floorf(gen->x) + (i % side) * step,
+            .y = floorf(gen->y) + (i / side) * step
+         };
+      }
+
+      case GEN_RINGS:
+      {
+         int per_ring = 64;
+         Index ring = i / per_ring;
+         Index rings = (gen->count + per_ring - 1) / per_ring;
+         float radius = size / 2 * (ring + 1) / (rings + 1);
+         float a = 2 * M_PI * (i % per_ring) / per_ring;
+         return (Point) {
+            .x = cx + radius * cosf(a),
+            .y = cy + radius * sinf(a)
+         };
+      }
+
+      case GEN_COLLINEAR:
+      {
+         // runs of 32 points, spaced 1 apart, on a horizontal, vertical or diagonal line
+         Index run = i / 32;
+         int k = (int)(i % 32);
+         Point start = gen_uniform(gen, -1000 - run);
+         start.x = floorf(fminf(start.x, gen->x + gen->width - 32));
+         start.y = floorf(fminf(start.y, gen->y + gen->height - 32));
+         int direction = (int)(run % 3);
+         return (Point) {
+            .x = start.x + (direction != 1 ? k : 0),
+            .y = start.y + (direction != 0 ? k : 0)
+         };
+      }
+
+      case GEN_DUPLICATES:
+      {
+         if (i > 0 && gen_random(gen, i, 2) < 0.1f)
+         {
+            Index earlier = (Index)(gen_random(gen, i, 3) * i);
+            return gen_uniform(gen, earlier);
+         }
+
+         return gen_uniform(gen, i);
+      }
+
+      case GEN_WIDE_RANGE:
+         return (Point) {
+            .x = (gen_random(gen, i, 0) * 2 - 1) * GEN_WIDE_EXTENT,
+            .y = (gen_random(gen, i, 1) * 2 - 1) * GEN_WIDE_EXTENT
+         };
+
+      default:
+         return gen_uniform(gen, i);
+   }
+}
+
+Generator gen_init(GenKind kind, uint64_t seed, Index count, float x, float y, float width, float height)
+{
+   Generator gen = {
+      .kind = kind,
+      .seed = splitmix64(seed),
+      .count = count,
+      .produced = 0,
+      .x = x,
+      .y = y,
+      .width = width,
+      .height = height
+   };
+
+   return gen;
+}
+
+int gen_next(Generator* gen, Point* out, int max)
+{
+   int written = 0;
+   while (written < max && gen->produced < gen->count)
+   {
+      out[written++] = gen_point(gen, gen->produced++);
+   }
+
+   return written;
+}
@@ -0,0 +1,38 @@
+#ifndef _GEN_H_
+#define _GEN_H_
+
+#include <stdint.h>
+#include "delaunay.h"
+
+typedef enum {
+   GEN_UNIFORM,         // uniform in the area
+   GEN_CLUSTERS,        // gaussian blobs around a few centers
+   GEN_GRID,            // exact integer grid
+   GEN_RINGS,           // concentric rings, many points per circle
+   GEN_COLLINEAR,       // runs of points on horizontal, vertical and diagonal lines
+   GEN_DUPLICATES,      // uniform, with about 1 point in 10 repeating an earlier one
+   GEN_WIDE_RANGE,      // uniform over +/- 1e7, whatever the area
+   GEN_COUNT
+} GenKind;
+
+// Point i only depends on the kind, the seed and i, so the same seed gives
+// the same points whatever chunk size they are read with.
+typedef struct {
+   GenKind kind;
+   uint64_t seed;
+   Index count;
+   Index produced;
+   float x;
+   float y;
+   float width;
+   float height;
+} Generator;
+
+Generator gen_init(GenKind kind, uint64_t seed, Index count, float x, float y, float width, float height);
+
+// Writes up to max points, returns how many, 0 when all count are done.
+int gen_next(Generator* gen, Point* out, int max);
+
+const char* gen_name(GenKind kind);
+
+#endif
@@ -0,0 +1,349 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "da.h"
+#include "delaunay.h"
+#include "parallel.h"
+#include "graph.h"
+
+#define GRAPH_CHUNK 4096
+
+typedef struct {
+   Delaunay* delaunay;
+   Index* offsets;      // first output edge of every chunk
+   Edge* out;           // NULL while counting
+} EdgeContext;
+
+// An edge belongs to the triangle with the lower index, or to its only triangle.
+void edge_chunk(void* ctx, int chunk)
+{
+   EdgeContext* ec = (EdgeContext*)ctx;
+   Delaunay* d = ec->delaunay;
+   Index begin = (Index)chunk * GRAPH_CHUNK;
+   Index end = begin + GRAPH_CHUNK < d->triangles.count ? begin + GRAPH_CHUNK : d->triangles.count;
+   Index count = 0;
+
+   for (Index t = begin; t < end; ++t)
+   {
+      Triangle* tr = &TRIA(d, t);
+      Index ix[3] = { tr->ix1, tr->ix2, tr->ix3 };
+      for (int e = 0; e < 3; ++e)
+      {
+         Index u = ix[e];
+         Index v = ix[(e + 1) % 3];
+         if (IS_SUPER_POINT(d, u) || IS_SUPER_POINT(d, v))
+         {
+            continue;
+         }
+
+         int slot;
+         Index n = neighbour_across(d, tr, u, v, &slot);
+         if (n != -1 && n < t)
+         {
+            continue;
+         }
+
+         if (ec->out != NULL)
+         {
+            ec->out[ec->offsets[chunk] + count] = (Edge) {
+               .u = u,
+               .v = v,
+               .length = distance(POINT(d, u), POINT(d, v))
+            };
+         }
+
+         count++;
+      }
+   }
+
+   if (ec->out == NULL)
+   {
+      ec->offsets[chunk + 1] = count;
+   }
+}
+
+Edges delaunay_edges(Delaunay* delaunay, int thread_count)
+{
+   int chunks = (int)((delaunay->triangles.count + GRAPH_CHUNK - 1) / GRAPH_CHUNK);
+   EdgeContext ec = {
+      .delaunay = delaunay,
+      .offsets = calloc(chunks + 1, sizeof(Index)),
+      .out = NULL
+   };
+
+   // count, then write every chunk at its own offset
+   parallel_for(chunks, thread_count, edge_chunk, &ec);
+   for (Index c = 0; c < chunks; ++c)
+   {
+      ec.offsets[c + 1] += ec.offsets[c];
+   }
+
+   Edges edges = { 0 };
+   edges.count = ec.offsets[chunks];
+   edges.capacity = edges.count > 0 ? edges.count : 1;
+   edges.items = malloc(edges.capacity * sizeof(Edge));
+   assert(edges.items != NULL && "Buy more RAM lol");
+
+   ec.out = edges.items;
+   parallel_for(chunks, thread_count, edge_chunk, &ec);
+
+   free(ec.offsets);
+   return edges;
+}
+
+int sort_by_length(const void* aa, const void* bb)
+{
+   const Edge* a = (const Edge*)aa;
+   const Edge* b = (const Edge*)bb;
+
+   return (a->length > b->length) - (a->length < b->length);
+}
+
+typedef struct {
+   Edge* items;
+   Index count;
+} SortContext;
+
+void sort_chunk(void* ctx, int chunk)
+{
+   SortContext* sc = (SortContext*)ctx;
+   Index begin = (Index)chunk * GRAPH_CHUNK;
+   Index end = begin + GRAPH_CHUNK < sc->count ? begin + GRAPH_CHUNK : sc->count;
+   qsort(sc->items + begin, end - begin, sizeof(Edge), sort_by_length);
+}
+
+// sorts the chunks in parallel, then merges them pairwise
+void parallel_sort_edges(Edges* edges, int thread_count)
+{
+   SortContext sc = { .items = edges->items, .count = edges->count };
+   int chunks = (int)((edges->count + GRAPH_CHUNK - 1) / GRAPH_CHUNK);
+   parallel_for(chunks, thread_count, sort_chunk, &sc);
+
+   Edge* temp = malloc((edges->count > 0 ? edges->count : 1) * sizeof(Edge));
+   Edge* from = edges->items;
+   Edge* to = temp;
+   for (Index width = GRAPH_CHUNK; width < edges->count; width *= 2)
+   {
+      for (Index begin = 0; begin < edges->count; begin += 2 * width)
+      {
+         Index mid = begin + width < edges->count ? begin + width : edges->count;
+         Index end = begin + 2 * width < edges->count ? begin + 2 * width : edges->count;
+         Index i = begin;
+         Index j = mid;
+         Index k = begin;
+         while (i < mid && j < end)
+         {
+            to[k++] = from[j].length < from[i].length ? from[j++] : from[i++];
+         }
+         while (i < mid)
+         {
+            to[k++] = from[i++];
+         }
+         while (j < end)
+         {
+            to[k++] = from[j++];
+         }
+      }
+
+      Edge* swap = from;
+      from = to;
+      to = swap;
+   }
+
+   if (from != edges->items)
+   {
+      memcpy(edges->items, from, edges->count * sizeof(Edge));
+   }
+
+   free(temp);
+}
+
+Index find_root(Index* parent, Index x)
+{
+   while (parent[x] != x)
+   {
+      parent[x] = parent[parent[x]];
+      x = parent[x];
+   }
+
+   return x;
+}
+
+Edges delaunay_emst(Delaunay* delaunay, int thread_count)
+{
+   Edges edges = delaunay_edges(delaunay, thread_count);
+   parallel_sort_edges(&edges, thread_count);
+
+   Index n = delaunay->points.count;
+   Index* parent = malloc(n * sizeof(Index));
+   Index* size = malloc(n * sizeof(Index));
+   for (Index i = 0; i < n; ++i)
+   {
+      parent[i] = i;
+      size[i] = 1;
+   }
+
+   // Kruskal, keeping the tree edges in place at the front
+   Index kept = 0;
+   for (Index e = 0; e < edges.count; ++e)
+   {
+      Index a = find_root(parent, edges.items[e].u);
+      Index b = find_root(parent, edges.items[e].v);
+      if (a == b)
+      {
+         continue;
+      }
+
+      if (size[a] < size[b])
+      {
+         Index temp = a;
+         a = b;
+         b = temp;
+      }
+
+      parent[b] = a;
+      size[a] += size[b];
+      edges.items[kept++] = edges.items[e];
+   }
+
+   edges.count = kept;
+   free(parent);
+   free(size);
+   return edges;
+}
+
+typedef struct {
+   Delaunay* delaunay;
+   Index* first;        // adjacency of point i: adjacent[first[i] .. first[i + 1] - 1]
+   Index* adjacent;
+   Index* result;
+   int k;
+} KnnContext;
+
+typedef struct {
+   Index point;
+   float distance;
+} Candidate;
+
+bool is_seen(Indices* seen, Index ix)
+{
+   for (Index i = 0; i < seen->count; ++i)
+   {
+      if (seen->items[i] == ix)
+      {
+         return true;
+      }
+   }
+
+   return false;
+}
+
+void knn_chunk(void* ctx, int chunk)
+{
+   KnnContext* kc = (KnnContext*)ctx;
+   Delaunay* d = kc->delaunay;
+   Index begin = (Index)chunk * GRAPH_CHUNK;
+   Index end = begin + GRAPH_CHUNK < d->points.count ? begin + GRAPH_CHUNK : d->points.count;
+
+   Indices seen = { 0 };
+   struct {
+      Candidate* items;
+      Index count;
+      Index capacity;
+   } candidates = { 0 };
+
+   for (Index p = begin; p < end; ++p)
+   {
+      Index* result = &kc->result[p * kc->k];
+      for (Index j = 0; j < kc->k; ++j)
+      {
+         result[j] = -1;
+      }
+
+      seen.count = 0;
+      candidates.count = 0;
+      da_append(&seen, p);
+
+      // best-first: the nearest candidate is the next neighbour, its
+      // Delaunay neighbours become candidates
+      Index from = p;
+      for (Index j = 0; j < kc->k; ++j)
+      {
+         for (Index a = kc->first[from]; a < kc->first[from + 1]; ++a)
+         {
+            Index q = kc->adjacent[a];
+            if (!is_seen(&seen, q))
+            {
+               da_append(&seen, q);
+               Candidate c = { .point = q, .distance = distance(POINT(d, p), POINT(d, q)) };
+               da_append(&candidates, c);
+            }
+         }
+
+         if (candidates.count == 0)
+         {
+            break;
+         }
+
+         Index best = 0;
+         for (Index c = 1; c < candidates.count; ++c)
+         {
+            if (candidates.items[c].distance < candidates.items[best].distance)
+            {
+               best = c;
+            }
+         }
+
+         from = candidates.items[best].point;
+         result[j] = from;
+         candidates.items[best] = candidates.items[--candidates.count];
+      }
+   }
+
+   da_free(seen);
+   da_free(candidates);
+}
+
+Index* delaunay_knn(Delaunay* delaunay, int k, int thread_count)
+{
+   Index n = delaunay->points.count;
+   Edges edges = delaunay_edges(delaunay, thread_count);
+
+   KnnContext kc = {
+      .delaunay = delaunay,
+      .first = calloc(n + 1, sizeof(Index)),
+      .adjacent = malloc((2 * edges.count > 0 ? 2 * edges.count : 1) * sizeof(Index)),
+      .result = malloc((n * k > 0 ? n * k : 1) * sizeof(Index)),
+      .k = k
+   };
+
+   for (Index e = 0; e < edges.count; ++e)
+   {
+      kc.first[edges.items[e].u + 1]++;
+      kc.first[edges.items[e].v + 1]++;
+   }
+
+   for (Index i = 0; i < n; ++i)
+   {
+      kc.first[i + 1] += kc.first[i];
+   }
+
+   Index* fill = malloc((n > 0 ? n : 1) * sizeof(Index));
+   memcpy(fill, kc.first, n * sizeof(Index));
+   for (Index e = 0; e < edges.count; ++e)
+   {
+      kc.adjacent[fill[edges.items[e].u]++] = edges.items[e].v;
+      kc.adjacent[fill[edges.items[e].v]++] = edges.items[e].u;
+   }
+
+   free(fill);
+   da_free(edges);
+
+   parallel_for((int)((n + GRAPH_CHUNK - 1) / GRAPH_CHUNK), thread_count, knn_chunk, &kc);
+
+   free(kc.first);
+   free(kc.adjacent);
+   return kc.result;
+}
@@ -0,0 +1,33 @@
+#ifndef _GRAPH_H_
+#define _GRAPH_H_
+
+#include "delaunay.h"
+
+typedef struct {
+   Index u;
+   Index v;
+   float length;
+} Edge;
+
+typedef struct {
+   Edge* items;
+   Index count;
+   Index capacity;
+} Edges;
+
+// Every edge of the mesh once, leaving out the super triangle.
+// thread_count <= 0 uses all online CPUs.
+Edges delaunay_edges(Delaunay* delaunay, int thread_count);
+
+// Euclidean minimum spanning tree: a subset of the Delaunay edges,
+// picked with Kruskal after a parallel sort on length.
+Edges delaunay_emst(Delaunay* delaunay, int thread_count);
+
+// The k nearest neighbours of every point, nearest first, in
+// result[i * k .. i * k + k - 1], padded with -1. The j-th nearest
+// neighbour is always a Delaunay neighbour of the point or of one of the
+// nearer ones, so a best-first walk over the edges finds them.
+// Free with free().
+Index* delaunay_knn(Delaunay* delaunay, int k, int thread_count);
+
+#endif
@@ -0,0 +1,269 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "da.h"
+#include "delaunay.h"
+#include "hull.h"
+
+#define IS_SUPER(ix) ((ix) < 3)
+
+void append_hull_edge(Indices* hull, Index u, Index v)
+{
+   if (hull->count == 0)
+   {
+      da_append(hull, u);
+      da_append(hull, v);
+      return;
+   }
+
+   Index last = hull->items[hull->count - 1];
+   if (hull->count == 2 && last != u && last != v)
+   {
+      // the first edge was taken the wrong way around
+      hull->items[1] = hull->items[0];
+      hull->items[0] = last;
+      last = hull->items[1];
+   }
+
+   da_append(hull, last == u ? v : u);
+}
+
+// Around the super triangle: every triangle of the ring that has exactly
+// one super point contributes its other edge, in ring order.
+void super_ring_hull(Delaunay* delaunay, Indices* hull)
+{
+   Index start = delaunay->hull_hint;
+   Index previous = -1;
+   Index current = start;
+
+   do
+   {
+      Triangle* tr = &TRIA(delaunay, current);
+      Index ix[3] = { tr->ix1, tr->ix2, tr->ix3 };
+      int supers = IS_SUPER(ix[0]) + IS_SUPER(ix[1]) + IS_SUPER(ix[2]);
+      if (supers == 1)
+      {
+         int s = IS_SUPER(ix[0]) ? 0 : (IS_SUPER(ix[1]) ? 1 : 2);
+         append_hull_edge(hull, ix[(s + 1) % 3], ix[(s + 2) % 3]);
+      }
+
+      // next ring triangle: across an edge with a super point
+      Index next = -1;
+      for (int e = 0; e < 3 && next == -1; ++e)
+      {
+         Index u = ix[e];
+         Index v = ix[(e + 1) % 3];
+         if (!IS_SUPER(u) && !IS_SUPER(v))
+         {
+            continue;
+         }
+
+         int slot;
+         Index n = neighbour_across(delaunay, tr, u, v, &slot);
+         if (n != -1 && n != previous)
+         {
+            next = n;
+         }
+      }
+
+      if (next == -1)
+      {
+         // a ring of two triangles: go back
+         next = previous;
+      }
+
+      previous = current;
+      current = next;
+   } while (current != start && current != -1);
+}
+
+// Around a finalized mesh: from a border edge u-v, turn around v through
+// the triangles sharing it until the next edge without a neighbour.
+void border_hull(Delaunay* delaunay, Indices* hull)
+{
+   Index t = delaunay->hull_hint;
+   Triangle* tr = &TRIA(delaunay, t);
+   Index ix[3] = { tr->ix1, tr->ix2, tr->ix3 };
+   Index u = -1;
+   Index v = -1;
+   int slot;
+   for (int e = 0; e < 3; ++e)
+   {
+      if (neighbour_across(delaunay, tr, ix[e], ix[(e + 1) % 3], &slot) == -1)
+      {
+         u = ix[e];
+         v = ix[(e + 1) % 3];
+         break;
+      }
+   }
+
+   Index start_u = u;
+   Index start_v = v;
+   do
+   {
+      append_hull_edge(hull, u, v);
+
+      // pivot around v, starting with the other edge of t at v
+      Index from = u;
+      for (;;)
+      {
+         tr = &TRIA(delaunay, t);
+         Index w = tr->ix1 != v && tr->ix1 != from ? tr->ix1 : (tr->ix2 != v && tr->ix2 != from ? tr->ix2 : tr->ix3);
+         Index n = neighbour_across(delaunay, tr, v, w, &slot);
+         if (n == -1)
+         {
+            u = v;
+            v = w;
+            break;
+         }
+
+         from = w;
+         t = n;
+      }
+   } while ((u != start_u || v != start_v) && hull->count <= delaunay->points.count + 1);
+}
+
+bool left_of(Delaunay* delaunay, Index a, Index b, Index c)
+{
+   return orient2d(&POINT(delaunay, a), &POINT(delaunay, b), &POINT(delaunay, c)) > 0;
+}
+
+// The scan pops every point on a hull edge except the seed ones, which are
+// never tested again. Drops those from the closed polygon.
+void drop_collinear(Delaunay* delaunay, Indices* polygon)
+{
+   Index* v = polygon->items;
+   Index first = 0;
+   Index count = 0;
+   for (Index i = 0; i < polygon->count; ++i)
+   {
+      while (count >= 2 && orient2d(&POINT(delaunay, v[count - 2]), &POINT(delaunay, v[count - 1]), &POINT(delaunay, v[i])) == 0)
+      {
+         count--;
+      }
+      v[count++] = v[i];
+   }
+
+   // around the seam, from both ends
+   bool changed = true;
+   while (changed && count - first >= 3)
+   {
+      changed = false;
+      if (orient2d(&POINT(delaunay, v[count - 2]), &POINT(delaunay, v[count - 1]), &POINT(delaunay, v[first])) == 0)
+      {
+         count--;
+         changed = true;
+      }
+      else if (orient2d(&POINT(delaunay, v[count - 1]), &POINT(delaunay, v[first]), &POINT(delaunay, v[first + 1])) == 0)
+      {
+         first++;
+         changed = true;
+      }
+   }
+
+   for (Index i = first; i < count; ++i)
+   {
+      v[i - first] = v[i];
+   }
+   polygon->count = count - first;
+}
+
+// https://en.wikipedia.org/wiki/Convex_hull_of_a_simple_polygon
+void melkman(Delaunay* delaunay, Indices* polygon)
+{
+   Index n = polygon->count;
+   Index* v = polygon->items;
+
+   // first corner that isn't collinear
+   Index k = 2;
+   while (k < n && orient2d(&POINT(delaunay, v[0]), &POINT(delaunay, v[1]), &POINT(delaunay, v[k])) == 0)
+   {
+      k++;
+   }
+
+   if (k >= n)
+   {
+      return;
+   }
+
+   // v[1 .. k - 1] run along a line away from v[0], the last one is the
+   // far end
+   Index* deque = malloc((2 * n + 1) * sizeof(Index));
+   Index bottom = n;
+   Index top = n + 3;
+   if (left_of(delaunay, v[0], v[k - 1], v[k]))
+   {
+      deque[n] = v[k];
+      deque[n + 1] = v[0];
+      deque[n + 2] = v[k - 1];
+   }
+   else
+   {
+      deque[n] = v[k];
+      deque[n + 1] = v[k - 1];
+      deque[n + 2] = v[0];
+   }
+   deque[n + 3] = v[k];
+
+   for (Index i = k + 1; i < n; ++i)
+   {
+      Index p = v[i];
+      if (left_of(delaunay, deque[bottom], deque[bottom + 1], p) && left_of(delaunay, deque[top - 1], deque[top], p))
+      {
+         continue;
+      }
+
+      while (!left_of(delaunay, deque[top - 1], deque[top], p))
+      {
+         top--;
+      }
+      deque[++top] = p;
+
+      while (!left_of(delaunay, p, deque[bottom], deque[bottom + 1]))
+      {
+         bottom++;
+      }
+      deque[--bottom] = p;
+   }
+
+   polygon->count = 0;
+   for (Index i = bottom; i < top; ++i)
+   {
+      polygon->items[polygon->count++] = deque[i];
+   }
+
+   free(deque);
+   drop_collinear(delaunay, polygon);
+}
+
+Index delaunay_hull(Delaunay* delaunay, Indices* hull)
+{
+   hull->count = 0;
+   if (delaunay->triangles.count == 0 || delaunay->hull_hint < 0)
+   {
+      return 0;
+   }
+
+   if (delaunay->finalized)
+   {
+      border_hull(delaunay, hull);
+   }
+   else
+   {
+      super_ring_hull(delaunay, hull);
+   }
+
+   // the walk ends where it started
+   if (hull->count > 1 && hull->items[hull->count - 1] == hull->items[0])
+   {
+      hull->count--;
+   }
+
+   // The super triangle is not infinitely far away, so the border of the
+   // real triangles can have dents. It is a simple polygon though, so
+   // Melkman's algorithm makes it convex in one more O(h) pass.
+   melkman(delaunay, hull);
+
+   return hull->count;
+}
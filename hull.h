@@ -0,0 +1,13 @@
+#ifndef _HULL_H_
+#define _HULL_H_
+
+#include "delaunay.h"
+
+// Counter-clockwise convex hull of the inserted points, as point indices,
+// corners only: points in the middle of a hull edge are left out.
+// Walks the ring of triangles around the super triangle (or the border of
+// a finalized mesh) from delaunay->hull_hint, so it costs O(h), not O(n).
+// Returns the number of hull points.
+Index delaunay_hull(Delaunay* delaunay, Indices* hull);
+
+#endif
@@ -0,0 +1,519 @@
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "da.h"
+#include "delaunay.h"
+#include "parallel.h"
+#include "profile.h"
+#include "utils.h"
+#include "insert.h"
+
+#define INSERT_CHUNK 256
+#define INSERT_MIN_ROUND 64
+
+typedef struct {
+   Index point;         // index in delaunay->points
+   Index triangle;      // where the walk starts, then the containing triangle, -1 when skipped
+   int chunk;           // whose lists hold the cavity
+   Index cavity;        // first cavity triangle in the chunk's list
+   Index cavity_count;
+   Index boundary;      // first boundary entry in the chunk's list
+   Index edge_count;
+   Index first_new;     // where the two extra triangles go
+   bool simple;         // the cavity is a disk: one more edge than triangles, plus one
+   bool won;
+} Insertion;
+
+typedef struct {
+   Delaunay* delaunay;
+   Insertion* round;    // this round's insertions, in rank order
+   Index round_count;
+   Indices* cavities;   // per chunk
+   Indices* boundaries;
+   _Atomic(Index)* owner; // rank + 1 of the best claim on every triangle, 0 when free
+} InsertContext;
+
+typedef struct {
+   uint32_t key;
+   Index index;
+} CurveKey;
+
+int sort_by_curve(const void* aa, const void* bb)
+{
+   const CurveKey* a = (const CurveKey*)aa;
+   const CurveKey* b = (const CurveKey*)bb;
+
+   return (a->key > b->key) - (a->key < b->key);
+}
+
+bool reserve(void** items, Index* capacity, Index needed, size_t size)
+{
+   if (*capacity >= needed)
+   {
+      return true;
+   }
+
+   void* grown = realloc(*items, (size_t)needed * size);
+   if (grown == NULL)
+   {
+      return false;
+   }
+
+   *items = grown;
+   *capacity = needed;
+   return true;
+}
+
+bool on_vertex(Delaunay* delaunay, Index t, Point* p)
+{
+   Triangle* tr = &TRIA(delaunay, t);
+   Index ix[3] = { tr->ix1, tr->ix2, tr->ix3 };
+   for (int k = 0; k < 3; ++k)
+   {
+      Point* v = &POINT(delaunay, ix[k]);
+      if (v->x == p->x && v->y == p->y)
+      {
+         return true;
+      }
+   }
+
+   return false;
+}
+
+// Sequential insertion of point pix, skipped when outside the super
+// triangle or on an existing vertex.
+bool insert_one(Delaunay* delaunay, Index pix, Index t, bool interpolate)
+{
+   Point* p = &POINT(delaunay, pix);
+   if (t == -1 || on_vertex(delaunay, t, p))
+   {
+      return false;
+   }
+
+   if (interpolate && delaunay->channels > 0)
+   {
+      delaunay_interpolate(delaunay, t, *p, &delaunay->attributes.items[pix * delaunay->channels]);
+   }
+
+   cavity_insert(delaunay, pix, t);
+   return true;
+}
+
+// smaller ranks win
+void claim(_Atomic(Index)* owner, Index t, Index mark)
+{
+   Index current = atomic_load(&owner[t]);
+   while ((current == 0 || mark < current) && !atomic_compare_exchange_weak(&owner[t], &current, mark))
+   {
+   }
+}
+
+// Only reads the mesh: locate, collect the cavity, claim it.
+void locate_chunk(void* ctx, int chunk)
+{
+   InsertContext* ic = (InsertContext*)ctx;
+   Delaunay* d = ic->delaunay;
+   Indices* cavity = &ic->cavities[chunk];
+   Indices* boundary = &ic->boundaries[chunk];
+   cavity->count = 0;
+   boundary->count = 0;
+
+   Index begin = (Index)chunk * INSERT_CHUNK;
+   Index end = begin + INSERT_CHUNK < ic->round_count ? begin + INSERT_CHUNK : ic->round_count;
+   for (Index i = begin; i < end; ++i)
+   {
+      Insertion* in = &ic->round[i];
+      Point* p = &POINT(d, in->point);
+      in->won = false;
+      in->triangle = locate_triangle_from(d, p, in->triangle);
+      if (in->triangle == -1 || on_vertex(d, in->triangle, p))
+      {
+         in->triangle = -1;
+         continue;
+      }
+
+      in->chunk = chunk;
+      in->cavity = cavity->count;
+      in->boundary = boundary->count;
+      collect_cavity(d, in->point, in->triangle, cavity, boundary);
+      in->cavity_count = cavity->count - in->cavity;
+      in->edge_count = (boundary->count - in->boundary) / 4;
+
+      // rounding can make the cavity something other than a disk, which
+      // takes more than two new triangles, left to cavity_insert()
+      in->simple = in->edge_count == in->cavity_count + 2;
+      if (!in->simple)
+      {
+         continue;
+      }
+
+      for (Index c = 0; c < in->cavity_count; ++c)
+      {
+         claim(ic->owner, cavity->items[in->cavity + c], i + 1);
+      }
+
+      for (Index e = 0; e < in->edge_count; ++e)
+      {
+         Index outside = boundary->items[in->boundary + e * 4 + 2];
+         if (outside != -1)
+         {
+            claim(ic->owner, outside, i + 1);
+         }
+      }
+   }
+}
+
+void check_chunk(void* ctx, int chunk)
+{
+   InsertContext* ic = (InsertContext*)ctx;
+   Index begin = (Index)chunk * INSERT_CHUNK;
+   Index end = begin + INSERT_CHUNK < ic->round_count ? begin + INSERT_CHUNK : ic->round_count;
+   for (Index i = begin; i < end; ++i)
+   {
+      Insertion* in = &ic->round[i];
+      if (in->triangle == -1 || !in->simple)
+      {
+         continue;
+      }
+
+      Indices* cavity = &ic->cavities[in->chunk];
+      Indices* boundary = &ic->boundaries[in->chunk];
+      bool won = true;
+      for (Index c = 0; c < in->cavity_count && won; ++c)
+      {
+         won = atomic_load(&ic->owner[cavity->items[in->cavity + c]]) == i + 1;
+      }
+
+      for (Index e = 0; e < in->edge_count && won; ++e)
+      {
+         Index outside = boundary->items[in->boundary + e * 4 + 2];
+         won = outside == -1 || atomic_load(&ic->owner[outside]) == i + 1;
+      }
+
+      in->won = won;
+   }
+}
+
+// The winners' cavities and their outside triangles don't overlap, so they
+// are rewritten side by side. Everybody drops its claims.
+void fan_chunk(void* ctx, int chunk)
+{
+   InsertContext* ic = (InsertContext*)ctx;
+   Index begin = (Index)chunk * INSERT_CHUNK;
+   Index end = begin + INSERT_CHUNK < ic->round_count ? begin + INSERT_CHUNK : ic->round_count;
+   for (Index i = begin; i < end; ++i)
+   {
+      Insertion* in = &ic->round[i];
+      if (in->triangle == -1 || !in->simple)
+      {
+         continue;
+      }
+
+      Index* cavity = &ic->cavities[in->chunk].items[in->cavity];
+      Index* boundary = &ic->boundaries[in->chunk].items[in->boundary];
+      for (Index c = 0; c < in->cavity_count; ++c)
+      {
+         atomic_store(&ic->owner[cavity[c]], 0);
+      }
+
+      for (Index e = 0; e < in->edge_count; ++e)
+      {
+         if (boundary[e * 4 + 2] != -1)
+         {
+            atomic_store(&ic->owner[boundary[e * 4 + 2]], 0);
+         }
+      }
+
+      if (in->won)
+      {
+         fan_cavity(ic->delaunay, in->point, cavity, in->cavity_count, boundary, in->edge_count, in->first_new);
+      }
+   }
+}
+
+typedef struct {
+   Delaunay* delaunay;
+   Index first;         // first batch point
+   Index* remap;        // new index of batch point first + i
+} RemapContext;
+
+void remap_chunk(void* ctx, int chunk)
+{
+   RemapContext* rc = (RemapContext*)ctx;
+   Delaunay* d = rc->delaunay;
+   Index begin = (Index)chunk * INSERT_CHUNK * 64;
+   Index end = begin + INSERT_CHUNK * 64 < d->triangles.count ? begin + INSERT_CHUNK * 64 : d->triangles.count;
+   for (Index t = begin; t < end; ++t)
+   {
+      Triangle* tr = &TRIA(d, t);
+      tr->ix1 = tr->ix1 >= rc->first ? rc->remap[tr->ix1 - rc->first] : tr->ix1;
+      tr->ix2 = tr->ix2 >= rc->first ? rc->remap[tr->ix2 - rc->first] : tr->ix2;
+      tr->ix3 = tr->ix3 >= rc->first ? rc->remap[tr->ix3 - rc->first] : tr->ix3;
+   }
+}
+
+Index delaunay_insert_batch(Delaunay* delaunay, const Point* points, const float* attributes, Index count, int thread_count)
+{
+   if (delaunay->finalized || delaunay->currentpoint < delaunay->points.count)
+   {
+      printf("ERROR: batch insertion needs a fully built mesh that isn't finalized\n");
+      return 0;
+   }
+
+   if (count <= 0)
+   {
+      return 0;
+   }
+
+   PROFILE_SCOPE("insert_batch");
+
+   // more threads than CPUs only make more clashes
+   int cpus = parallel_cpu_count();
+   thread_count = thread_count <= 0 || thread_count > cpus ? cpus : thread_count;
+
+   // the batch goes to the end of the points, along a Hilbert curve
+   float minx = FLT_MAX;
+   float maxx = -FLT_MAX;
+   float miny = FLT_MAX;
+   float maxy = -FLT_MAX;
+   for (Index i = 0; i < count; ++i)
+   {
+      minx = fminf(points[i].x, minx);
+      maxx = fmaxf(points[i].x, maxx);
+      miny = fminf(points[i].y, miny);
+      maxy = fmaxf(points[i].y, maxy);
+   }
+
+   float scalex = maxx > minx ? 65535.0f / (maxx - minx) : 0;
+   float scaley = maxy > miny ? 65535.0f / (maxy - miny) : 0;
+   CurveKey* keys = malloc(count * sizeof(CurveKey));
+   assert(keys != NULL && "Buy more RAM lol");
+   for (Index i = 0; i < count; ++i)
+   {
+      keys[i] = (CurveKey) {
+         .key = hilbert_index((uint32_t)((points[i].x - minx) * scalex), (uint32_t)((points[i].y - miny) * scaley)),
+         .index = i
+      };
+   }
+   qsort(keys, count, sizeof(CurveKey), sort_by_curve);
+
+   Index first = delaunay->points.count;
+   int channels = delaunay->channels;
+   for (Index i = 0; i < count; ++i)
+   {
+      da_append(&delaunay->points, points[keys[i].index]);
+      for (int c = 0; c < channels; ++c)
+      {
+         da_append(&delaunay->attributes, attributes != NULL ? attributes[keys[i].index * channels + c] : 0.0f);
+      }
+   }
+   free(keys);
+
+   if (delaunay->grid.cells == NULL)
+   {
+      delaunay_use_grid(delaunay, 0);
+   }
+
+   // every insertion adds two triangles, room for all of them up front
+   Index max_triangles = delaunay->triangles.count + 2 * count;
+   bool ok = reserve((void**)&delaunay->triangles.items, &delaunay->triangles.capacity, max_triangles, sizeof(Triangle));
+   assert(ok && "Buy more RAM lol");
+
+   Index* pending = malloc(count * sizeof(Index));
+   Index* hints = malloc(count * sizeof(Index));
+   Index* taken = malloc(count * sizeof(Index));
+   bool* skipped = calloc(count, sizeof(bool));
+   int max_chunks = (int)((count + INSERT_CHUNK - 1) / INSERT_CHUNK);
+   InsertContext ic = {
+      .delaunay = delaunay,
+      .round = malloc(count * sizeof(Insertion)),
+      .cavities = calloc(max_chunks, sizeof(Indices)),
+      .boundaries = calloc(max_chunks, sizeof(Indices)),
+      .owner = calloc(max_triangles, sizeof(_Atomic(Index)))
+   };
+   assert(pending != NULL && hints != NULL && taken != NULL && skipped != NULL && ic.round != NULL && ic.cavities != NULL && ic.boundaries != NULL && ic.owner != NULL && "Buy more RAM lol");
+
+   for (Index i = 0; i < count; ++i)
+   {
+      pending[i] = first + i;
+      hints[i] = -1;
+   }
+
+   Index pending_count = count;
+   Index inserted = 0;
+   Index owner_capacity = max_triangles;
+
+   // on one thread the rounds are only overhead: every point walks from
+   // the one before it along the curve
+   if (thread_count == 1)
+   {
+      for (Index i = 0; i < count; ++i)
+      {
+         Index t = locate_triangle(delaunay, &POINT(delaunay, first + i));
+         skipped[i] = !insert_one(delaunay, first + i, t, attributes == NULL);
+         inserted += skipped[i] ? 0 : 1;
+      }
+      pending_count = 0;
+   }
+
+   Index round = INSERT_MIN_ROUND;
+   while (pending_count > 0)
+   {
+      // A round is spread evenly over the pending points, so over the area
+      // of the batch, and grows while enough of it gets in: points landing
+      // in the same coarse triangles all clash until the mesh around them
+      // is finer, as with a randomized insertion order. Ranks are shuffled
+      // (Knuth's multiplicative hash, a bijection below 2^31) so that clashes
+      // aren't always won towards the start of the curve.
+      ic.round_count = round < pending_count ? round : pending_count;
+      for (Index i = 0; i < ic.round_count; ++i)
+      {
+         uint64_t spread = (uint64_t)i * 2654435761u % (uint64_t)ic.round_count;
+         taken[i] = (Index)(spread * pending_count / ic.round_count);
+         ic.round[i] = (Insertion) { .point = pending[taken[i]], .triangle = hints[pending[taken[i]] - first] };
+         pending[taken[i]] = -1;
+      }
+      int chunks = (int)((ic.round_count + INSERT_CHUNK - 1) / INSERT_CHUNK);
+
+      PROFILE_BEGIN("locate");
+      parallel_for(chunks, thread_count, locate_chunk, &ic);
+      parallel_for(chunks, thread_count, check_chunk, &ic);
+      PROFILE_END();
+
+      // winners get their new slots in rank order
+      Index winners = 0;
+      for (Index i = 0; i < ic.round_count; ++i)
+      {
+         Insertion* in = &ic.round[i];
+         if (!in->won)
+         {
+            continue;
+         }
+
+         in->first_new = delaunay->triangles.count + 2 * winners++;
+         if (channels > 0 && attributes == NULL)
+         {
+            delaunay_interpolate(delaunay, in->triangle, POINT(delaunay, in->point), &delaunay->attributes.items[in->point * channels]);
+         }
+      }
+      delaunay->triangles.count += 2 * winners;
+
+      PROFILE_BEGIN("fan");
+      parallel_for(chunks, thread_count, fan_chunk, &ic);
+      PROFILE_END();
+
+      // hints and grid, the losers go back to where they were taken from
+      // and walk from where they ended this time
+      for (Index i = 0; i < ic.round_count; ++i)
+      {
+         Insertion* in = &ic.round[i];
+         if (in->won)
+         {
+            Index* boundary = &ic.boundaries[in->chunk].items[in->boundary];
+            for (Index e = 0; e < in->edge_count; ++e)
+            {
+               track_triangle(delaunay, boundary[e * 4 + 3]);
+            }
+            inserted++;
+         }
+         else if (in->triangle == -1)
+         {
+            skipped[in->point - first] = true;
+         }
+         else if (!in->simple)
+         {
+            Index t = locate_triangle_from(delaunay, &POINT(delaunay, in->point), in->triangle);
+            skipped[in->point - first] = !insert_one(delaunay, in->point, t, attributes == NULL);
+            inserted += skipped[in->point - first] ? 0 : 1;
+         }
+         else
+         {
+            pending[taken[i]] = in->point;
+            hints[in->point - first] = in->triangle;
+         }
+      }
+
+      Index kept = 0;
+      for (Index i = 0; i < pending_count; ++i)
+      {
+         if (pending[i] != -1)
+         {
+            pending[kept++] = pending[i];
+         }
+      }
+
+      if (2 * winners >= ic.round_count)
+      {
+         round *= 2;
+      }
+      else if (8 * winners < ic.round_count && round > INSERT_MIN_ROUND)
+      {
+         round /= 2;
+      }
+      pending_count = kept;
+
+      // room for the rest, cavity_insert() may have taken more than two
+      // triangles for a point
+      Index needed = delaunay->triangles.count + 2 * pending_count;
+      if (needed > owner_capacity)
+      {
+         Index old = owner_capacity;
+         ok = reserve((void**)&delaunay->triangles.items, &delaunay->triangles.capacity, needed, sizeof(Triangle))
+              && reserve((void**)&ic.owner, &owner_capacity, needed, sizeof(_Atomic(Index)));
+         assert(ok && "Buy more RAM lol");
+         for (Index t = old; t < owner_capacity; ++t)
+         {
+            atomic_init(&ic.owner[t], 0);
+         }
+      }
+   }
+
+   // close the gaps the skipped points left
+   if (inserted < count)
+   {
+      Index* remap = malloc(count * sizeof(Index));
+      Index next = first;
+      for (Index i = 0; i < count; ++i)
+      {
+         remap[i] = skipped[i] ? -1 : next;
+         if (!skipped[i])
+         {
+            POINT(delaunay, next) = POINT(delaunay, first + i);
+            for (int c = 0; c < channels; ++c)
+            {
+               delaunay->attributes.items[next * channels + c] = delaunay->attributes.items[(first + i) * channels + c];
+            }
+            next++;
+         }
+      }
+
+      RemapContext rc = { .delaunay = delaunay, .first = first, .remap = remap };
+      parallel_for((int)((delaunay->triangles.count + INSERT_CHUNK * 64 - 1) / (INSERT_CHUNK * 64)), thread_count, remap_chunk, &rc);
+      delaunay->points.count = next;
+      delaunay->attributes.count = next * channels;
+      free(remap);
+   }
+
+   delaunay->currentpoint = delaunay->points.count;
+
+   for (int c = 0; c < max_chunks; ++c)
+   {
+      da_free(ic.cavities[c]);
+      da_free(ic.boundaries[c]);
+   }
+   free(ic.cavities);
+   free(ic.boundaries);
+   free(ic.owner);
+   free(ic.round);
+   free(pending);
+   free(hints);
+   free(taken);
+   free(skipped);
+   return inserted;
+}
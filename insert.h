@@ -0,0 +1,26 @@
+#ifndef _INSERT_H_
+#define _INSERT_H_
+
+#include "delaunay.h"
+
+// Inserts count more points into a fully built, not finalized mesh, on
+// thread_count threads (<= 0 or more than there are: all online CPUs).
+// attributes holds delaunay->channels values per point, or is NULL to
+// interpolate them.
+//
+// Works in rounds spread over the batch. Every point of the round locates
+// itself and collects its Bowyer-Watson cavity in parallel, then claims
+// the cavity and the triangles around it with its rank. The points that
+// hold all their claims touch disjoint parts of the mesh and are fanned in
+// in parallel, which gives the same mesh as inserting them one by one. The
+// others retry next round, walking from where they got to. A cavity that
+// rounding made into something other than a disk is inserted on its own
+// with cavity_insert(). On one thread the points are simply inserted one
+// by one. Turns on the LocateGrid if it isn't already.
+//
+// Points outside the super triangle or on an existing vertex are skipped.
+// Returns the number of points inserted, they are appended to the points
+// in Hilbert order.
+Index delaunay_insert_batch(Delaunay* delaunay, const Point* points, const float* attributes, Index count, int thread_count);
+
+#endif
@@ -0,0 +1,99 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "delaunay.h"
+#include "libdelaunay.h"
+
+_Static_assert(sizeof(DelaunayCoord) == sizeof(Coord), "libdelaunay.h built with other coordinates than the library");
+_Static_assert(sizeof(DelaunayIndex) == sizeof(Index), "libdelaunay.h built with other indices than the library");
+_Static_assert(sizeof(Point) == 2 * sizeof(DelaunayCoord), "xy is read as an array of Point");
+
+uint32_t delaunay_lib_abi(void)
+{
+   return DELAUNAY_LIB_ABI;
+}
+
+DelaunayIndex delaunay_lib_triangulate(const DelaunayCoord* xy, DelaunayIndex point_count, DelaunayMesh* mesh)
+{
+   // repeated points are merged up front, silently: triangles use the
+   // first of them
+   Delaunay d = delaunay_init_dedupe((const Point*)xy, NULL, 0, point_count, ENGINE_CAVITY, 0);
+   while (d.currentpoint < d.points.count)
+   {
+      delaunay_step(&d);
+   }
+
+   // number the triangles that don't touch the super triangle
+   Index* remap = malloc((d.triangles.count > 0 ? d.triangles.count : 1) * sizeof(Index));
+   Index kept = 0;
+   for (Index t = 0; t < d.triangles.count; ++t)
+   {
+      Triangle* tr = &TRIAV(d, t);
+      remap[t] = (tr->ix1 < 3 || tr->ix2 < 3 || tr->ix3 < 3) ? -1 : kept++;
+   }
+
+   if (mesh->triangles == NULL)
+   {
+      mesh->triangles = malloc((kept > 0 ? kept : 1) * 3 * sizeof(DelaunayIndex));
+      mesh->neighbours = malloc((kept > 0 ? kept : 1) * 3 * sizeof(DelaunayIndex));
+      assert(mesh->triangles != NULL && mesh->neighbours != NULL && "Buy more RAM lol");
+      mesh->capacity = kept;
+      mesh->owned = 1;
+   }
+   else if (mesh->capacity < kept)
+   {
+      mesh->count = kept;
+      free(remap);
+      delaunay_free(&d);
+      return -1;
+   }
+
+   for (Index t = 0; t < d.triangles.count; ++t)
+   {
+      if (remap[t] == -1)
+      {
+         continue;
+      }
+
+      Triangle* tr = &TRIAV(d, t);
+      Index ix[3] = { tr->ix1, tr->ix2, tr->ix3 };
+      if (orient2d(&POINTV(d, ix[0]), &POINTV(d, ix[1]), &POINTV(d, ix[2])) < 0)
+      {
+         ix[1] = tr->ix3;
+         ix[2] = tr->ix2;
+      }
+
+      DelaunayIndex* out = &mesh->triangles[remap[t] * 3];
+      for (int k = 0; k < 3; ++k)
+      {
+         out[k] = d.source.items[ix[k] - 3];
+      }
+
+      if (mesh->neighbours != NULL)
+      {
+         out = &mesh->neighbours[remap[t] * 3];
+         for (int k = 0; k < 3; ++k)
+         {
+            int slot;
+            Index n = neighbour_across(&d, tr, ix[(k + 1) % 3], ix[(k + 2) % 3], &slot);
+            out[k] = n == -1 ? -1 : remap[n];
+         }
+      }
+   }
+
+   free(remap);
+   delaunay_free(&d);
+   mesh->count = kept;
+   return kept;
+}
+
+void delaunay_lib_free(DelaunayMesh* mesh)
+{
+   if (mesh->owned)
+   {
+      free(mesh->triangles);
+      free(mesh->neighbours);
+   }
+
+   *mesh = (DelaunayMesh) { 0 };
+}
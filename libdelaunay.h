@@ -0,0 +1,75 @@
+#ifndef _LIBDELAUNAY_H_
+#define _LIBDELAUNAY_H_
+
+// Stable C interface of libdelaunay.a / libdelaunay.so.
+//
+// Only integers, floats and pointers to flat arrays cross it, so other
+// languages can bind it without the internal headers. Points are read in
+// place from the caller's buffer, results are written as flat arrays of
+// three entries per triangle that can be mapped as they are (a numpy array
+// of shape (count, 3), a Rust slice, ...).
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Must be built with the same DELAUNAY_INT_COORDS / DELAUNAY_INDEX64 as the
+// library. Bindings that can't see the defines compare delaunay_lib_abi()
+// with the layout they expect.
+#ifdef DELAUNAY_INT_COORDS
+typedef int32_t DelaunayCoord;
+#else
+typedef float DelaunayCoord;
+#endif
+
+#ifdef DELAUNAY_INDEX64
+typedef int64_t DelaunayIndex;
+#else
+typedef int32_t DelaunayIndex;
+#endif
+
+#define DELAUNAY_LIB_VERSION 1
+
+// The library is built with hidden symbols, these are the only ones
+// exported from libdelaunay.so
+#if defined(__GNUC__)
+#define DELAUNAY_LIB_API __attribute__((visibility("default")))
+#else
+#define DELAUNAY_LIB_API
+#endif
+
+// version << 16 | sizeof(DelaunayCoord) << 8 | sizeof(DelaunayIndex)
+#define DELAUNAY_LIB_ABI ((DELAUNAY_LIB_VERSION << 16) | (sizeof(DelaunayCoord) << 8) | sizeof(DelaunayIndex))
+
+typedef struct {
+   DelaunayIndex* triangles;    // 3 per triangle: indices into the caller's points, counter-clockwise
+   DelaunayIndex* neighbours;   // 3 per triangle: the triangle across the edge opposite vertex k, -1 on the hull
+   DelaunayIndex count;         // triangles written, or needed when the capacity was too small
+   DelaunayIndex capacity;      // triangles the arrays have room for
+   int32_t owned;               // 1 when the library allocated the arrays
+} DelaunayMesh;
+
+DELAUNAY_LIB_API uint32_t delaunay_lib_abi(void);
+
+// Triangulates the point_count points in xy (x0, y0, x1, y1, ...). xy is
+// only read, during the call. Points that repeat an earlier one are not
+// used by any triangle.
+//
+// With mesh->triangles set, the results go into the caller's arrays, which
+// have room for mesh->capacity triangles (2 * point_count is always
+// enough), and mesh->neighbours may be NULL to skip adjacency. Otherwise
+// the library allocates both arrays, free them with delaunay_lib_free().
+//
+// Returns the number of triangles, or -1 when the capacity is too small.
+DELAUNAY_LIB_API DelaunayIndex delaunay_lib_triangulate(const DelaunayCoord* xy, DelaunayIndex point_count, DelaunayMesh* mesh);
+
+// Frees arrays allocated by the library and zeroes the mesh.
+DELAUNAY_LIB_API void delaunay_lib_free(DelaunayMesh* mesh);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -7,12 +7,13 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <time.h>
 #include "raylib.h"
 #include "raymath.h"
 #include "da.h"
 #include "utils.h"
 #include "delaunay.h"
+#include "gen.h"
+#include "hull.h"
 
 #define WIDTH        800
 #define HEIGHT       600
@@ -21,6 +22,8 @@
 
 #define POINT_RADIUS  5
 #define POINT_COUNT   35
+#define GEN_KIND      GEN_RINGS
+#define GEN_SEED      13
 
 Font text_font;
 Font number_font;
@@ -34,6 +37,7 @@ typedef struct {
 LocalPoints points = { 0 };
 
 Delaunay delaunay;
+Indices hull = { 0 };
 
 int offsetx = 0;
 int offsety = 0;
@@ -41,48 +45,18 @@ int offsety = 0;
 void init()
 {
    points.count = 0;
-   
-   #if 0
-   // Grid
-   for (int y = 100; y < HEIGHT - BORDER; y += 50)
+
+   // any generator of gen.h, inside the border
+   Generator gen = gen_init(GEN_KIND, GEN_SEED, POINT_COUNT, BORDER, BORDER, WIDTH - BORDER * 2, HEIGHT - BORDER * 2);
+   Point chunk[64];
+   int produced;
+   while ((produced = gen_next(&gen, chunk, 64)) > 0)
    {
-      for (int x = 100; x < WIDTH - BORDER; x += 50)
+      for (int i = 0; i < produced; ++i)
       {
-         Point p = {
-            .x = x + (rand() % 20) - 10,
-            .y = y + (rand() % 20) - 10
-         };
-         
-         da_append(&points, p);
+         da_append(&points, chunk[i]);
       }
    }
-   #endif
-
-   #if 1
-   // Cirlce
-   for (float i = 0; i < 2 * M_PI; i += PI / 10)
-   {
-         Point p = {
-            .x = sin(i) * WIDTH / 4 + WIDTH / 2 + (rand() % 10) - 20,
-            .y = cos(i) * HEIGHT / 4 + HEIGHT / 2 + (rand() % 10) - 20,
-         };
-         
-         da_append(&points, p);
-   }
-   #endif
-
-   #if 0
-   // Random
-   for (int i = 0; i < POINT_COUNT; ++i)
-   {
-      Point p = {
-         .x = (rand() % (WIDTH - BORDER * 2)) + BORDER,
-         .y = (rand() % (HEIGHT - BORDER * 2)) + BORDER
-      };
-      
-      da_append(&points, p);
-   }
-   #endif
    
    delaunay_free(&delaunay);
    delaunay = delaunay_init(points.items, points.count);
@@ -235,24 +209,15 @@ void draw()
 {
    //printf("main: Triangle count: %d\n", delaunay.triangles.count);
 
-   for (int i = 0; i < delaunay.triangles.count; ++i)
+   for (Index i = 0; i < delaunay.triangles.count; ++i)
    {
       //printf("Triangle %d: %d %d %d\n", i, delaunay.triangles.items[i].ix1, delaunay.triangles.items[i].ix2, delaunay.triangles.items[i].ix3);
       Point p1 = POINTV(delaunay, TRIAV(delaunay, i).ix1);
       Point p2 = POINTV(delaunay, TRIAV(delaunay, i).ix2);
       Point p3 = POINTV(delaunay, TRIAV(delaunay, i).ix3);
 
-      if (p1.x == 2000 || p2.x == 2000 || p3.x == 2000)
-         continue;
-      if (p1.y == 2000 || p2.y == 2000 || p3.y == 2000)
-         continue;
-      if (p1.x == -2000 || p2.x == -2000 || p3.x == -2000)
-         continue;
-      if (p1.y == -2000 || p2.y == -2000 || p3.y == -2000)
-         continue;
-      if (p1.x == 1000 || p2.x == 1000 || p3.x == 1000)
-         continue;
-      if (p1.y == 1000 || p2.y == 1000 || p3.y == 1000)
+      // skip the super triangle
+      if (TRIAV(delaunay, i).ix1 < 3 || TRIAV(delaunay, i).ix2 < 3 || TRIAV(delaunay, i).ix3 < 3)
          continue;
 
       //printf(" = %.1f, %.1f  --  %.1f, %.1f  --  %.1f, %.1f\n", p1.x, p1.y, p2.x, p2.y, p3.x, p3.x);
@@ -275,7 +240,15 @@ void draw()
       */
    }
 
-   for (int i = 0; i < delaunay.points.count; ++i)
+   delaunay_hull(&delaunay, &hull);
+   for (Index i = 0; i < hull.count; ++i)
+   {
+      Point p1 = POINTV(delaunay, hull.items[i]);
+      Point p2 = POINTV(delaunay, hull.items[(i + 1) % hull.count]);
+      DrawLine(p1.x + offsetx, p1.y + offsety, p2.x + offsetx, p2.y + offsety, GREEN);
+   }
+
+   for (Index i = 0; i < delaunay.points.count; ++i)
    {
       draw_point(POINTV(delaunay, i), RED);
       draw_number(POINTV(delaunay, i).x + 10 + offsetx, POINTV(delaunay, i).y + 5 + offsety, i);
@@ -284,8 +257,6 @@ void draw()
 
 int main(void)
 {
-   srand(time(NULL));
-   //srand(13);
    SetConfigFlags(FLAG_MSAA_4X_HINT);  // Try to enable MSAA 4X
    // SetConfigFlags(FLAG_WINDOW_RESIZABLE);
    InitWindow(WIDTH, HEIGHT, "Delaunay Triangulation");
@@ -360,6 +331,7 @@ int main(void)
    UnloadFont(text_font);
 
    da_free(points);
+   da_free(hull);
 
    CloseWindow();
 
@@ -0,0 +1,186 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "parallel.h"
+#include "profile.h"
+
+typedef struct {
+   atomic_int next;
+   int task_count;
+   ParallelTask task;
+   void* ctx;
+} Work;
+
+// Helper threads, started on first use and kept for the life of the
+// process. One parallel_for at a time owns them, the others (concurrent
+// or nested calls) start threads of their own.
+typedef struct {
+   pthread_mutex_t owner;     // held by the parallel_for using the pool
+   pthread_mutex_t lock;      // guards everything below
+   pthread_cond_t wake;
+   pthread_cond_t done;
+   int thread_count;
+   long generation;           // bumped for every job
+   Work* work;
+   int slots;                 // helpers that may still join the job
+   int active;                // helpers that joined and haven't finished
+} Pool;
+
+Pool pool = {
+   .owner = PTHREAD_MUTEX_INITIALIZER,
+   .lock = PTHREAD_MUTEX_INITIALIZER,
+   .wake = PTHREAD_COND_INITIALIZER,
+   .done = PTHREAD_COND_INITIALIZER
+};
+
+int parallel_cpu_count(void)
+{
+   long n = sysconf(_SC_NPROCESSORS_ONLN);
+   return n < 1 ? 1 : (int)n;
+}
+
+void* parallel_worker(void* arg)
+{
+   Work* work = (Work*)arg;
+   for (;;)
+   {
+      int ix = atomic_fetch_add(&work->next, 1);
+      if (ix >= work->task_count)
+      {
+         break;
+      }
+
+      PROFILE_SCOPE("task");
+      work->task(work->ctx, ix);
+   }
+
+   return NULL;
+}
+
+void* pool_thread(void* arg)
+{
+   (void)arg;
+   long seen = 0;
+   pthread_mutex_lock(&pool.lock);
+   for (;;)
+   {
+      while (pool.generation == seen || pool.slots == 0)
+      {
+         seen = pool.generation;
+         pthread_cond_wait(&pool.wake, &pool.lock);
+      }
+
+      seen = pool.generation;
+      pool.slots--;
+      pool.active++;
+      Work* work = pool.work;
+      pthread_mutex_unlock(&pool.lock);
+
+      parallel_worker(work);
+
+      pthread_mutex_lock(&pool.lock);
+      if (--pool.active == 0)
+      {
+         pthread_cond_signal(&pool.done);
+      }
+   }
+
+   return NULL;
+}
+
+// Grows the pool to helpers threads, returns how many there are.
+int pool_grow(int helpers)
+{
+   while (pool.thread_count < helpers)
+   {
+      pthread_t thread;
+      if (pthread_create(&thread, NULL, pool_thread, NULL) != 0)
+      {
+         break;
+      }
+
+      pthread_detach(thread);
+      pool.thread_count++;
+   }
+
+   return pool.thread_count < helpers ? pool.thread_count : helpers;
+}
+
+// For when the pool is taken: threads for this call only.
+void spawn_for(Work* work, int thread_count)
+{
+   pthread_t* threads = malloc((thread_count - 1) * sizeof(pthread_t));
+   int started = 0;
+   for (int i = 0; i < thread_count - 1; ++i)
+   {
+      if (pthread_create(&threads[started], NULL, parallel_worker, work) == 0)
+      {
+         started++;
+      }
+   }
+
+   parallel_worker(work);
+
+   for (int i = 0; i < started; ++i)
+   {
+      pthread_join(threads[i], NULL);
+   }
+
+   free(threads);
+}
+
+void parallel_for(int task_count, int thread_count, ParallelTask task, void* ctx)
+{
+   if (thread_count <= 0)
+   {
+      thread_count = parallel_cpu_count();
+   }
+
+   if (thread_count > task_count)
+   {
+      thread_count = task_count;
+   }
+
+   Work work = {
+      .task_count = task_count,
+      .task = task,
+      .ctx = ctx
+   };
+   atomic_init(&work.next, 0);
+
+   if (thread_count <= 1)
+   {
+      parallel_worker(&work);
+      return;
+   }
+
+   if (pthread_mutex_trylock(&pool.owner) != 0)
+   {
+      spawn_for(&work, thread_count);
+      return;
+   }
+
+   // the calling thread is one of the workers
+   pthread_mutex_lock(&pool.lock);
+   pool.work = &work;
+   pool.slots = pool_grow(thread_count - 1);
+   pool.generation++;
+   pthread_cond_broadcast(&pool.wake);
+   pthread_mutex_unlock(&pool.lock);
+
+   parallel_worker(&work);
+
+   // helpers that didn't get to it by now have nothing left to do
+   pthread_mutex_lock(&pool.lock);
+   pool.slots = 0;
+   while (pool.active > 0)
+   {
+      pthread_cond_wait(&pool.done, &pool.lock);
+   }
+   pool.work = NULL;
+   pthread_mutex_unlock(&pool.lock);
+
+   pthread_mutex_unlock(&pool.owner);
+}
@@ -0,0 +1,15 @@
+#ifndef _PARALLEL_H_
+#define _PARALLEL_H_
+
+// Runs task(ctx, ix) for every ix in [0, task_count) on thread_count threads.
+// Threads grab the next task from a shared atomic counter, so a thread that
+// finishes early keeps pulling work until everything is done.
+// thread_count <= 0 means one thread per online CPU. The helper threads are
+// kept in a pool across calls, a call made while another one holds the
+// pool (from a task, or from another thread) starts its own.
+typedef void (*ParallelTask)(void* ctx, int ix);
+
+void parallel_for(int task_count, int thread_count, ParallelTask task, void* ctx);
+int parallel_cpu_count(void);
+
+#endif
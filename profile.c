@@ -0,0 +1,200 @@
+#ifdef DELAUNAY_PROFILE
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "profile.h"
+
+// events per thread, the oldest get overwritten
+#define PROFILE_RING_SIZE (1 << 16)
+
+typedef struct {
+   const char* name;
+   long long ns;
+   bool begin;
+} ProfileEvent;
+
+typedef struct ProfileRing {
+   ProfileEvent events[PROFILE_RING_SIZE];
+   long long written;
+   int tid;
+   const char* open[64];      // names of the spans still open, for profile_end()
+   int depth;
+   struct ProfileRing* next;
+   struct ProfileRing* next_free;
+} ProfileRing;
+
+pthread_mutex_t profile_lock = PTHREAD_MUTEX_INITIALIZER;
+ProfileRing* profile_rings = NULL;
+ProfileRing* profile_free_rings = NULL;   // of threads that exited, taken by the next new ones
+int profile_threads = 0;
+pthread_key_t profile_key;
+pthread_once_t profile_key_once = PTHREAD_ONCE_INIT;
+_Atomic(ProfileHook) profile_hook = NULL;
+_Thread_local ProfileRing* profile_ring = NULL;
+
+long long profile_now()
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Thread exit: the ring keeps its events for profile_dump() and goes to
+// the next thread that starts profiling, which continues it as the same tid.
+void release_ring(void* arg)
+{
+   ProfileRing* ring = (ProfileRing*)arg;
+   pthread_mutex_lock(&profile_lock);
+   ring->depth = 0;
+   ring->next_free = profile_free_rings;
+   profile_free_rings = ring;
+   pthread_mutex_unlock(&profile_lock);
+}
+
+void create_key(void)
+{
+   pthread_key_create(&profile_key, release_ring);
+}
+
+ProfileRing* thread_ring()
+{
+   if (profile_ring == NULL)
+   {
+      pthread_once(&profile_key_once, create_key);
+      pthread_mutex_lock(&profile_lock);
+      if (profile_free_rings != NULL)
+      {
+         profile_ring = profile_free_rings;
+         profile_free_rings = profile_ring->next_free;
+      }
+      else
+      {
+         profile_ring = calloc(1, sizeof(ProfileRing));
+         profile_ring->tid = ++profile_threads;
+         profile_ring->next = profile_rings;
+         profile_rings = profile_ring;
+      }
+      pthread_mutex_unlock(&profile_lock);
+      pthread_setspecific(profile_key, profile_ring);
+   }
+
+   return profile_ring;
+}
+
+void record(const char* name, bool begin)
+{
+   ProfileRing* ring = thread_ring();
+   ProfileEvent* e = &ring->events[ring->written % PROFILE_RING_SIZE];
+   e->name = name;
+   e->ns = profile_now();
+   e->begin = begin;
+   ring->written++;
+
+   ProfileHook hook = atomic_load_explicit(&profile_hook, memory_order_relaxed);
+   if (hook != NULL)
+   {
+      hook(name, begin);
+   }
+}
+
+int profile_begin(const char* name)
+{
+   ProfileRing* ring = thread_ring();
+   if (ring->depth < 64)
+   {
+      ring->open[ring->depth] = name;
+   }
+   ring->depth++;
+
+   record(name, true);
+   return 0;
+}
+
+void profile_end(void)
+{
+   ProfileRing* ring = thread_ring();
+   if (ring->depth == 0)
+   {
+      return;
+   }
+
+   ring->depth--;
+   record(ring->depth < 64 ? ring->open[ring->depth] : "?", false);
+}
+
+void profile_scope_end(int* scope)
+{
+   (void)scope;
+   profile_end();
+}
+
+void profile_set_hook(ProfileHook hook)
+{
+   atomic_store(&profile_hook, hook);
+}
+
+void profile_trace_marker(const char* name, bool begin)
+{
+   static int fd = -2;
+   if (fd == -2)
+   {
+      fd = open("/sys/kernel/tracing/trace_marker", O_WRONLY | O_CLOEXEC);
+      if (fd == -1)
+      {
+         fd = open("/sys/kernel/debug/tracing/trace_marker", O_WRONLY | O_CLOEXEC);
+      }
+   }
+
+   if (fd < 0)
+   {
+      return;
+   }
+
+   char temp[256];
+   int len = begin
+      ? snprintf(temp, sizeof(temp), "B|%d|%s", (int)getpid(), name)
+      : snprintf(temp, sizeof(temp), "E|%d", (int)getpid());
+   if (write(fd, temp, len) < 0)
+   {
+      // tracing switched off, nothing to do
+   }
+}
+
+// Dumps what the rings hold. Call it while no other thread is profiling.
+bool profile_dump(const char* path)
+{
+   FILE* f = fopen(path, "w");
+   if (f == NULL)
+   {
+      printf("ERROR: can't write profile %s\n", path);
+      return false;
+   }
+
+   fprintf(f, "{\"traceEvents\":[\n");
+   bool first = true;
+
+   pthread_mutex_lock(&profile_lock);
+   for (ProfileRing* ring = profile_rings; ring != NULL; ring = ring->next)
+   {
+      long long start = ring->written > PROFILE_RING_SIZE ? ring->written - PROFILE_RING_SIZE : 0;
+      for (long long i = start; i < ring->written; ++i)
+      {
+         ProfileEvent* e = &ring->events[i % PROFILE_RING_SIZE];
+         fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d}",
+                 first ? "" : ",\n", e->name, e->begin ? 'B' : 'E', e->ns / 1000.0, (int)getpid(), ring->tid);
+         first = false;
+      }
+   }
+   pthread_mutex_unlock(&profile_lock);
+
+   fprintf(f, "\n]}\n");
+   return fclose(f) == 0;
+}
+
+#endif
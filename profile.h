@@ -0,0 +1,50 @@
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+// Optional phase profiling. Build with -DDELAUNAY_PROFILE to record spans
+// into a per-thread ring buffer and dump them as Chrome trace-event JSON
+// (chrome://tracing, Perfetto). The ring of a thread that exits is taken
+// over by the next new one. Without it every macro below is empty.
+//
+//    PROFILE_SCOPE("sort");          // span until the end of the block
+//    PROFILE_BEGIN("flip"); ... PROFILE_END();
+//    PROFILE_DUMP("trace.json");
+
+#include <stdbool.h>
+
+// Called on every span begin and end, e.g. to emit perf/ftrace markers.
+typedef void (*ProfileHook)(const char* name, bool begin);
+
+#ifdef DELAUNAY_PROFILE
+
+int profile_begin(const char* name);
+void profile_end(void);
+void profile_scope_end(int* scope);
+bool profile_dump(const char* path);
+void profile_set_hook(ProfileHook hook);
+
+// Writes "B|pid|name" / "E|pid" to the ftrace trace_marker, which
+// `perf record -e ftrace:print` and `perf script` pick up.
+void profile_trace_marker(const char* name, bool begin);
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+#define PROFILE_SCOPE(name) \
+   __attribute__((cleanup(profile_scope_end))) int PROFILE_CONCAT(profile_scope_, __LINE__) = profile_begin(name)
+#define PROFILE_BEGIN(name) profile_begin(name)
+#define PROFILE_END() profile_end()
+#define PROFILE_DUMP(path) profile_dump(path)
+#define PROFILE_SET_HOOK(hook) profile_set_hook(hook)
+
+#else
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_BEGIN(name)
+#define PROFILE_END()
+#define PROFILE_DUMP(path)
+#define PROFILE_SET_HOOK(hook)
+
+#endif
+
+#endif
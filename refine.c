@@ -0,0 +1,211 @@
+// Chew/Ruppert-style refinement without input segments: the domain is the
+// convex hull, and circumcenters that fall outside of it are skipped, so
+// slivers along the hull are left as they are.
+
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "da.h"
+#include "delaunay.h"
+#include "refine.h"
+
+typedef struct {
+   float badness;
+   Index triangle;
+   Index ix1;
+   Index ix2;
+   Index ix3;
+} BadTriangle;
+
+// binary max-heap on badness
+typedef struct {
+   BadTriangle* items;
+   Index count;
+   Index capacity;
+} BadHeap;
+
+void heap_push(BadHeap* heap, BadTriangle item)
+{
+   da_append(heap, item);
+
+   Index i = heap->count - 1;
+   while (i > 0 && heap->items[(i - 1) / 2].badness < heap->items[i].badness)
+   {
+      BadTriangle temp = heap->items[i];
+      heap->items[i] = heap->items[(i - 1) / 2];
+      heap->items[(i - 1) / 2] = temp;
+      i = (i - 1) / 2;
+   }
+}
+
+BadTriangle heap_pop(BadHeap* heap)
+{
+   BadTriangle top = heap->items[0];
+   heap->items[0] = heap->items[--heap->count];
+
+   Index i = 0;
+   for (;;)
+   {
+      Index largest = i;
+      Index l = 2 * i + 1;
+      Index r = 2 * i + 2;
+      if (l < heap->count && heap->items[l].badness > heap->items[largest].badness)
+      {
+         largest = l;
+      }
+
+      if (r < heap->count && heap->items[r].badness > heap->items[largest].badness)
+      {
+         largest = r;
+      }
+
+      if (largest == i)
+      {
+         break;
+      }
+
+      BadTriangle temp = heap->items[i];
+      heap->items[i] = heap->items[largest];
+      heap->items[largest] = temp;
+      i = largest;
+   }
+
+   return top;
+}
+
+// > 1 when the triangle breaks a target. The angle test uses the
+// circumradius to shortest edge ratio, which is 1 / (2 sin(min angle)).
+float badness(Delaunay* delaunay, Index t, float max_ratio, float max_area)
+{
+   Triangle* tr = &TRIA(delaunay, t);
+   if (tr->ix1 < 3 || tr->ix2 < 3 || tr->ix3 < 3)
+   {
+      return 0;
+   }
+
+   Point a = POINT(delaunay, tr->ix1);
+   Point b = POINT(delaunay, tr->ix2);
+   Point c = POINT(delaunay, tr->ix3);
+
+   float shortest = fminf(distance(a, b), fminf(distance(b, c), distance(c, a)));
+   float result = shortest > 0 ? tr->circle.radius / shortest / max_ratio : 0;
+
+   if (max_area > 0)
+   {
+      float area = fabsf(((float)b.x - a.x) * ((float)c.y - a.y) - ((float)b.y - a.y) * ((float)c.x - a.x)) / 2;
+      result = fmaxf(result, area / max_area);
+   }
+
+   return result;
+}
+
+void enqueue(Delaunay* delaunay, BadHeap* heap, Index t, float max_ratio, float max_area)
+{
+   float bad = badness(delaunay, t, max_ratio, max_area);
+   if (bad > 1)
+   {
+      Triangle* tr = &TRIA(delaunay, t);
+      BadTriangle item = {
+         .badness = bad,
+         .triangle = t,
+         .ix1 = tr->ix1,
+         .ix2 = tr->ix2,
+         .ix3 = tr->ix3
+      };
+      heap_push(heap, item);
+   }
+}
+
+Index delaunay_refine(Delaunay* delaunay, RefineOptions options)
+{
+   if (delaunay->finalized || delaunay->currentpoint < delaunay->points.count)
+   {
+      printf("ERROR: refine needs a complete, not finalized mesh\n");
+      return 0;
+   }
+
+   if (delaunay->grid.cells == NULL)
+   {
+      delaunay_use_grid(delaunay, 0);
+   }
+
+   float max_ratio = options.min_angle > 0 ? 1.0f / (2 * sinf(options.min_angle * M_PI / 180)) : INFINITY;
+   BadHeap heap = { 0 };
+   for (Index t = 0; t < delaunay->triangles.count; ++t)
+   {
+      enqueue(delaunay, &heap, t, max_ratio, options.max_area);
+   }
+
+   Index inserted = 0;
+   while (heap.count > 0 && (options.max_points == 0 || inserted < options.max_points))
+   {
+      BadTriangle bad = heap_pop(&heap);
+      Triangle* tr = &TRIA(delaunay, bad.triangle);
+      if (tr->ix1 != bad.ix1 || tr->ix2 != bad.ix2 || tr->ix3 != bad.ix3)
+      {
+         // replaced since it was queued
+         continue;
+      }
+
+      Point center = {
+         .x = (Coord)tr->circle.center.x,
+         .y = (Coord)tr->circle.center.y
+      };
+
+      Index t = locate_triangle(delaunay, &center);
+      if (t == -1)
+      {
+         continue;
+      }
+
+      Triangle* host = &TRIA(delaunay, t);
+      if (host->ix1 < 3 || host->ix2 < 3 || host->ix3 < 3)
+      {
+         // outside the convex hull
+         continue;
+      }
+
+      Point* a = &POINT(delaunay, host->ix1);
+      Point* b = &POINT(delaunay, host->ix2);
+      Point* c = &POINT(delaunay, host->ix3);
+      if ((a->x == center.x && a->y == center.y) || (b->x == center.x && b->y == center.y) || (c->x == center.x && c->y == center.y))
+      {
+         continue;
+      }
+
+      Index pix = delaunay->points.count;
+      da_append(&delaunay->points, center);
+      for (int k = 0; k < delaunay->channels; ++k)
+      {
+         da_append(&delaunay->attributes, 0.0f);
+      }
+      delaunay_interpolate(delaunay, t, center, &delaunay->attributes.items[pix * delaunay->channels]);
+      delaunay_step(delaunay);
+      inserted++;
+
+      if (delaunay->engine == ENGINE_CAVITY)
+      {
+         // the new triangles are listed in the cavity boundary
+         for (Index e = 0; e < delaunay->boundary.count / 4; ++e)
+         {
+            enqueue(delaunay, &heap, delaunay->boundary.items[e * 4 + 3], max_ratio, options.max_area);
+         }
+      }
+      else
+      {
+         for (Index i = 0; i < delaunay->triangles.count; ++i)
+         {
+            Triangle* nt = &TRIA(delaunay, i);
+            if (nt->ix1 == pix || nt->ix2 == pix || nt->ix3 == pix)
+            {
+               enqueue(delaunay, &heap, i, max_ratio, options.max_area);
+            }
+         }
+      }
+   }
+
+   da_free(heap);
+   return inserted;
+}
@@ -0,0 +1,20 @@
+#ifndef _REFINE_H_
+#define _REFINE_H_
+
+#include "delaunay.h"
+
+typedef struct {
+   float min_angle;     // degrees, smaller angles get split (keep below ~30)
+   float max_area;      // 0 = no area limit
+   Index max_points;    // stop after inserting this many points, 0 = no limit
+} RefineOptions;
+
+// Inserts the circumcenters of bad triangles, worst first, until every
+// triangle inside the convex hull meets the options or max_points is hit.
+// The mesh must be fully built and not finalized. Turns on the LocateGrid
+// if it isn't already, circumcenters come in no spatial order.
+// New points take attributes interpolated in the triangle they land in.
+// Returns the number of points inserted.
+Index delaunay_refine(Delaunay* delaunay, RefineOptions options);
+
+#endif
@@ -0,0 +1,352 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "da.h"
+#include "delaunay.h"
+#include "parallel.h"
+#include "tin.h"
+
+#define TIN_CHUNK 4096
+
+// The part of one level's contour inside one triangle: from the crossing on
+// edge a to the crossing on edge b. Edge e runs from vertex e to e + 1.
+typedef struct {
+   Index triangle;
+   int level;
+   int8_t a;
+   int8_t b;
+} Segment;
+
+typedef struct {
+   Delaunay* delaunay;
+   int channel;
+   float* levels;       // ascending, no repeats
+   int level_count;
+   Index* first;        // segments of triangle t: segments[first[t] .. first[t + 1] - 1], by level
+   Segment* segments;   // NULL while counting
+   Index* by_level;     // segments of level l: by_level[level_first[l] .. level_first[l + 1] - 1]
+   Index* level_first;
+   uint8_t* visited;
+   ContourSink sink;
+   void* ctx;
+   pthread_mutex_t lock;
+   Index polylines;
+} TinContext;
+
+float vertex_value(TinContext* tc, Index ix)
+{
+   return tc->delaunay->attributes.items[ix * tc->delaunay->channels + tc->channel];
+}
+
+// first level above value
+int level_above(TinContext* tc, float value)
+{
+   int lo = 0;
+   int hi = tc->level_count;
+   while (lo < hi)
+   {
+      int mid = (lo + hi) / 2;
+      if (tc->levels[mid] > value)
+      {
+         hi = mid;
+      }
+      else
+      {
+         lo = mid + 1;
+      }
+   }
+
+   return lo;
+}
+
+void segment_chunk(void* ctx, int chunk)
+{
+   TinContext* tc = (TinContext*)ctx;
+   Delaunay* d = tc->delaunay;
+   Index begin = (Index)chunk * TIN_CHUNK;
+   Index end = begin + TIN_CHUNK < d->triangles.count ? begin + TIN_CHUNK : d->triangles.count;
+
+   for (Index t = begin; t < end; ++t)
+   {
+      Triangle* tr = &TRIA(d, t);
+      if (IS_SUPER_POINT(d, tr->ix1) || IS_SUPER_POINT(d, tr->ix2) || IS_SUPER_POINT(d, tr->ix3))
+      {
+         if (tc->segments == NULL)
+         {
+            tc->first[t + 1] = 0;
+         }
+         continue;
+      }
+
+      float z[3] = { vertex_value(tc, tr->ix1), vertex_value(tc, tr->ix2), vertex_value(tc, tr->ix3) };
+      float lo = z[0] < z[1] ? (z[0] < z[2] ? z[0] : z[2]) : (z[1] < z[2] ? z[1] : z[2]);
+      float hi = z[0] > z[1] ? (z[0] > z[2] ? z[0] : z[2]) : (z[1] > z[2] ? z[1] : z[2]);
+
+      // crossed by the levels in (lo, hi]
+      int from = level_above(tc, lo);
+      int to = level_above(tc, hi);
+      if (tc->segments == NULL)
+      {
+         tc->first[t + 1] = to - from;
+         continue;
+      }
+
+      Segment* out = &tc->segments[tc->first[t]];
+      for (int l = from; l < to; ++l)
+      {
+         Segment seg = { .triangle = t, .level = l, .a = -1, .b = -1 };
+         for (int e = 0; e < 3; ++e)
+         {
+            if ((z[e] >= tc->levels[l]) != (z[(e + 1) % 3] >= tc->levels[l]))
+            {
+               if (seg.a == -1)
+               {
+                  seg.a = e;
+               }
+               else
+               {
+                  seg.b = e;
+               }
+            }
+         }
+
+         *out++ = seg;
+      }
+   }
+}
+
+void edge_points(Delaunay* delaunay, Segment* seg, int edge, Index* u, Index* v)
+{
+   Triangle* tr = &TRIA(delaunay, seg->triangle);
+   Index ix[3] = { tr->ix1, tr->ix2, tr->ix3 };
+   *u = ix[edge];
+   *v = ix[(edge + 1) % 3];
+}
+
+// Where the level crosses the edge. Computed from the lower point index
+// up, so the two triangles sharing the edge agree to the bit.
+Vec2f crossing(TinContext* tc, Segment* seg, int edge)
+{
+   Index u, v;
+   edge_points(tc->delaunay, seg, edge, &u, &v);
+   if (u > v)
+   {
+      Index temp = u;
+      u = v;
+      v = temp;
+   }
+
+   Point* pu = &POINT(tc->delaunay, u);
+   Point* pv = &POINT(tc->delaunay, v);
+   double zu = vertex_value(tc, u);
+   double zv = vertex_value(tc, v);
+   double s = (tc->levels[seg->level] - zu) / (zv - zu);
+   return (Vec2f) {
+      .x = (float)(pu->x + s * ((double)pv->x - pu->x)),
+      .y = (float)(pu->y + s * ((double)pv->y - pu->y))
+   };
+}
+
+// The segment of the same level in the triangle across edge of s, and the
+// edge it is entered by. -1 on the hull.
+Index segment_across(TinContext* tc, Index s, int edge, int* entered)
+{
+   Delaunay* d = tc->delaunay;
+   Segment* seg = &tc->segments[s];
+   Index u, v;
+   edge_points(d, seg, edge, &u, &v);
+
+   int slot;
+   Index n = neighbour_across(d, &TRIA(d, seg->triangle), u, v, &slot);
+   if (n == -1)
+   {
+      return -1;
+   }
+
+   for (Index k = tc->first[n]; k < tc->first[n + 1]; ++k)
+   {
+      Segment* next = &tc->segments[k];
+      if (next->level != seg->level)
+      {
+         continue;
+      }
+
+      Index nu, nv;
+      edge_points(d, next, next->a, &nu, &nv);
+      *entered = (nu == u && nv == v) || (nu == v && nv == u) ? next->a : next->b;
+      return k;
+   }
+
+   return -1;
+}
+
+int other_edge(Segment* seg, int edge)
+{
+   return seg->a == edge ? seg->b : seg->a;
+}
+
+void stitch_level(void* ctx, int level)
+{
+   TinContext* tc = (TinContext*)ctx;
+   Index steps = tc->level_first[level + 1] - tc->level_first[level];
+   struct {
+      Vec2f* items;
+      Index count;
+      Index capacity;
+   } line = { 0 };
+
+   for (Index i = tc->level_first[level]; i < tc->level_first[level + 1]; ++i)
+   {
+      Index s = tc->by_level[i];
+      if (tc->visited[s])
+      {
+         continue;
+      }
+
+      // back up to where the line enters the mesh, or all the way around
+      Index start = s;
+      int start_edge = tc->segments[s].a;
+      for (Index k = 0; k < steps; ++k)
+      {
+         int entered;
+         Index previous = segment_across(tc, start, start_edge, &entered);
+         if (previous == -1 || previous == s || tc->visited[previous])
+         {
+            break;
+         }
+
+         start = previous;
+         start_edge = other_edge(&tc->segments[previous], entered);
+      }
+
+      // then follow it forward
+      line.count = 0;
+      da_append(&line, crossing(tc, &tc->segments[start], start_edge));
+      bool closed = false;
+      Index current = start;
+      int exit = other_edge(&tc->segments[start], start_edge);
+      for (Index k = 0; k < steps; ++k)
+      {
+         tc->visited[current] = 1;
+         int entered;
+         Index next = segment_across(tc, current, exit, &entered);
+         if (next == start)
+         {
+            closed = true;
+            break;
+         }
+
+         da_append(&line, crossing(tc, &tc->segments[current], exit));
+         if (next == -1 || tc->visited[next])
+         {
+            break;
+         }
+
+         current = next;
+         exit = other_edge(&tc->segments[next], entered);
+      }
+
+      pthread_mutex_lock(&tc->lock);
+      tc->sink(tc->ctx, tc->levels[level], line.items, line.count, closed);
+      tc->polylines++;
+      pthread_mutex_unlock(&tc->lock);
+   }
+
+   da_free(line);
+}
+
+int sort_floats(const void* aa, const void* bb)
+{
+   float a = *(const float*)aa;
+   float b = *(const float*)bb;
+
+   return (a > b) - (a < b);
+}
+
+Index delaunay_contours(Delaunay* delaunay, int channel, const float* levels, int level_count, int thread_count, ContourSink sink, void* ctx)
+{
+   if (channel < 0 || channel >= delaunay->channels)
+   {
+      printf("ERROR: no attribute channel %d, the mesh has %d\n", channel, delaunay->channels);
+      return -1;
+   }
+
+   TinContext tc = {
+      .delaunay = delaunay,
+      .channel = channel,
+      .levels = malloc((level_count > 0 ? level_count : 1) * sizeof(float)),
+      .first = malloc((delaunay->triangles.count + 1) * sizeof(Index)),
+      .sink = sink,
+      .ctx = ctx
+   };
+   assert(tc.levels != NULL && tc.first != NULL && "Buy more RAM lol");
+   pthread_mutex_init(&tc.lock, NULL);
+
+   for (int l = 0; l < level_count; ++l)
+   {
+      tc.levels[l] = levels[l];
+   }
+   qsort(tc.levels, level_count, sizeof(float), sort_floats);
+   for (int l = 0; l < level_count; ++l)
+   {
+      if (tc.level_count == 0 || tc.levels[l] != tc.levels[tc.level_count - 1])
+      {
+         tc.levels[tc.level_count++] = tc.levels[l];
+      }
+   }
+
+   // count per triangle, then write every triangle's segments at its offset
+   int chunks = (int)((delaunay->triangles.count + TIN_CHUNK - 1) / TIN_CHUNK);
+   tc.first[0] = 0;
+   parallel_for(chunks, thread_count, segment_chunk, &tc);
+   for (Index t = 0; t < delaunay->triangles.count; ++t)
+   {
+      tc.first[t + 1] += tc.first[t];
+   }
+
+   Index segment_count = tc.first[delaunay->triangles.count];
+   tc.segments = malloc((segment_count > 0 ? segment_count : 1) * sizeof(Segment));
+   tc.visited = calloc(segment_count > 0 ? segment_count : 1, 1);
+   tc.by_level = malloc((segment_count > 0 ? segment_count : 1) * sizeof(Index));
+   tc.level_first = calloc(tc.level_count + 1, sizeof(Index));
+   assert(tc.segments != NULL && tc.visited != NULL && tc.by_level != NULL && tc.level_first != NULL && "Buy more RAM lol");
+   parallel_for(chunks, thread_count, segment_chunk, &tc);
+
+   // group by level, then chain every level on its own
+   for (Index s = 0; s < segment_count; ++s)
+   {
+      tc.level_first[tc.segments[s].level + 1]++;
+   }
+
+   for (int l = 0; l < tc.level_count; ++l)
+   {
+      tc.level_first[l + 1] += tc.level_first[l];
+   }
+
+   Index* fill = malloc((tc.level_count > 0 ? tc.level_count : 1) * sizeof(Index));
+   for (int l = 0; l < tc.level_count; ++l)
+   {
+      fill[l] = tc.level_first[l];
+   }
+
+   for (Index s = 0; s < segment_count; ++s)
+   {
+      tc.by_level[fill[tc.segments[s].level]++] = s;
+   }
+   free(fill);
+
+   parallel_for(tc.level_count, thread_count, stitch_level, &tc);
+
+   pthread_mutex_destroy(&tc.lock);
+   free(tc.levels);
+   free(tc.first);
+   free(tc.segments);
+   free(tc.visited);
+   free(tc.by_level);
+   free(tc.level_first);
+   return tc.polylines;
+}
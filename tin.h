@@ -0,0 +1,22 @@
+#ifndef _TIN_H_
+#define _TIN_H_
+
+#include <stdbool.h>
+#include "delaunay.h"
+
+// Receives one contour polyline: count points, the last one joined back to
+// the first when closed. Called from the worker threads, one call at a
+// time, in no particular order. points is only valid during the call.
+typedef void (*ContourSink)(void* ctx, float level, const Vec2f* points, Index count, bool closed);
+
+// Iso-contours of attribute channel over the triangulated irregular
+// network, at every level. A vertex is above a level when its value is >=
+// the level, so contours never run through vertices and every crossed
+// triangle holds exactly one segment per level. Segments are found per
+// triangle in parallel, then chained through the neighbours, one task per
+// level; lines end on the hull. Triangles touching the super triangle are
+// left out. thread_count <= 0 uses all online CPUs.
+// Returns the number of polylines sent to sink, -1 on a bad channel.
+Index delaunay_contours(Delaunay* delaunay, int channel, const float* levels, int level_count, int thread_count, ContourSink sink, void* ctx);
+
+#endif
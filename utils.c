@@ -4,3 +4,31 @@ float map(float value, float minin, float maxin, float minout, float maxout)
 {
 	return minout + (value - minin) / (maxin - minin) * (maxout - minout);
 }
+
+// Position of (x, y) along a Hilbert curve over a 65536 x 65536 grid.
+// https://en.wikipedia.org/wiki/Hilbert_curve#Applications_and_mapping_algorithms
+uint32_t hilbert_index(uint32_t x, uint32_t y)
+{
+	uint32_t d = 0;
+	for (uint32_t s = 1 << 15; s > 0; s /= 2)
+	{
+		uint32_t rx = (x & s) > 0;
+		uint32_t ry = (y & s) > 0;
+		d += s * s * ((3 * rx) ^ ry);
+
+		if (ry == 0)
+		{
+			if (rx == 1)
+			{
+				x = 65535 - x;
+				y = 65535 - y;
+			}
+
+			uint32_t t = x;
+			x = y;
+			y = t;
+		}
+	}
+
+	return d;
+}
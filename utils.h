@@ -4,7 +4,10 @@
 #define min(a, b) (a) < (b) ? (a) : (b)
 #define max(a, b) (a) > (b) ? (a) : (b)
 
+#include <stdint.h>
+
 float map(float value, float minin, float maxin, float minout, float maxout);
+uint32_t hilbert_index(uint32_t x, uint32_t y);
 
 #endif
 
@@ -2,17 +2,43 @@
 #define _VECTOR2_H_
 
 #include <math.h>
+#include <stdint.h>
 
+// Coordinate type of input points.
+// Build with -DDELAUNAY_INT_COORDS to use exact int32 coordinates.
+// Every point, the super triangle's included, must stay within
+// +/- DELAUNAY_COORD_MAX so the in-circle determinant fits in 128 bits.
+// The super triangle reaches up to 16 times as far from the center as the
+// input, so input points must stay within +/- DELAUNAY_INPUT_MAX.
+#ifdef DELAUNAY_INT_COORDS
+typedef int32_t Coord;
+#define DELAUNAY_COORD_MAX (1 << 28)
+#define DELAUNAY_INPUT_MAX (DELAUNAY_COORD_MAX / 20)
+#else
+typedef float Coord;
+#endif
+
+typedef struct {
+   Coord x;
+   Coord y;
+} Vec2;
+
+// Always floating point: circle centers, midpoints, ...
 typedef struct {
    float x;
    float y;
-} Vec2;
+} Vec2f;
 
 inline float distance(Vec2 a, Vec2 b)
 {
-   return sqrtf((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y));
+   float dx = (float)a.x - (float)b.x;
+   float dy = (float)a.y - (float)b.y;
+   return sqrtf(dx * dx + dy * dy);
 }
 
+inline float distancef(Vec2f a, Vec2f b)
+{
+   return sqrtf((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y));
+}
 
 #endif
-